@@ -38,6 +38,23 @@ typedef struct gdt_entry_struct
 }
   __attribute__ ((packed)) gdt_entry;
 
+typedef struct tss_entry_struct
+{
+  u32int prev_tss; //back link to the task that was interrupted
+  u32int esp0, ss0, esp1, ss1, esp2, ss2;
+  u32int cr3;
+  u32int eip, eflags, eax, ecx, edx, ebx;
+  u32int esp, ebp, esi, edi;
+  u32int es, cs, ss, ds, fs, gs;
+  u32int ldt;
+  u16int trap;
+  u16int iomap_base;
+}
+  __attribute__ ((packed)) tss_entry;
+
+// GDT selectors of the task state segments
+#define KERNEL_TSS_SEL 0x28
+#define FAULT_TSS_SEL  0x30
 
 void idt_set_gate(u8int idx, u32int base, u16int sel, u8int flags);
 u32int idt_get_gate(u32int idx);
@@ -47,4 +64,7 @@ void gdt_init_entry(int idx, u32int base, u32int limit, u8int access,
 void init_idt();
 void init_gdt();
 
+tss_entry* get_kernel_tss();
+void set_fault_tss_cr3(u32int cr3);
+
 #endif
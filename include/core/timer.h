@@ -0,0 +1,54 @@
+#ifndef _TIMER_H
+#define _TIMER_H
+
+#include <system.h>
+
+// Rate at which the PIT raises IRQ0, in interrupts per second
+#define TIMER_FREQUENCY 100
+
+/*
+  Procedure..: init_timer
+  Description..: Programs channel 0 of the programmable interval
+      timer to fire at the given frequency, installs the IRQ0
+      handler and unmasks IRQ0 on the master PIC.
+  Params..: frequency - interrupts per second
+*/
+void init_timer(u32int frequency);
+
+/*
+  Procedure..: timer_tick
+  Description..: Advances the tick counter. Called once per IRQ0.
+*/
+void timer_tick(void);
+
+/*
+  Procedure..: get_ticks
+  Description..: Returns the number of timer interrupts since boot.
+*/
+u32int get_ticks(void);
+
+/*
+  Procedure..: ms_to_ticks
+  Description..: Converts milliseconds into timer ticks, rounding
+      up so that a wait of that many ticks is never too short.
+  Params..: ms - the number of milliseconds
+*/
+u32int ms_to_ticks(u32int ms);
+
+/*
+  Procedure..: cycles_to_ms
+  Description..: Converts a count of CPU cycles (see tsc.h) into
+      milliseconds, using the cycle rate measured against the
+      timer since init_timer.
+  Params..: cycles - the number of cycles to convert
+*/
+u32int cycles_to_ms(u64int cycles);
+
+/*
+  Procedure..: cycles_to_us
+  Description..: Converts a count of CPU cycles into microseconds.
+  Params..: cycles - the number of cycles to convert
+*/
+u32int cycles_to_us(u64int cycles);
+
+#endif
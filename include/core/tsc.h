@@ -0,0 +1,38 @@
+#ifndef _TSC_H
+#define _TSC_H
+
+#include <system.h>
+
+/*
+  Procedure..: rdtsc
+  Description..: Reads the processor's time stamp counter, which
+      counts CPU cycles since reset.
+*/
+static inline u64int rdtsc()
+{
+  u32int lo, hi;
+  asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+  return ((u64int)hi << 32) | lo;
+}
+
+/*
+  Procedure..: div64
+  Description..: Divides a 64 bit value by a 32 bit one. There is
+      no libgcc in the kernel to do 64 bit division for us, so
+      this is done as two 32 bit divides (high half, then the
+      remainder with the low half), neither of which can overflow.
+  Params..: n - the dividend, d - the divisor (non-zero)
+*/
+static inline u64int div64(u64int n, u32int d)
+{
+  u32int hi = (u32int)(n >> 32);
+  u32int lo = (u32int)n;
+  u32int q_hi = hi / d;
+  u32int r = hi % d;
+  u32int q_lo;
+
+  asm ("divl %4" : "=a"(q_lo), "=d"(r) : "a"(lo), "d"(r), "rm"(d));
+  return ((u64int)q_hi << 32) | q_lo;
+}
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef _BUDDY_H
+#define _BUDDY_H
+
+#include <system.h>
+
+/* Virtual address range that blocks of whole pages (process
+   stacks, large heap blocks) are mapped into */
+#define PAGE_REGION_BASE 0xE000000
+#define PAGE_REGION_SIZE 0x1000000
+#define PAGE_REGION_PAGES (PAGE_REGION_SIZE / 0x1000)
+
+/* Blocks are 2^0 up to 2^12 pages; the largest is the whole region */
+#define BUDDY_ORDERS 13
+
+/*
+  Procedure..: init_buddy
+  Description..: Makes the whole page region one free block.
+      Its page tables must already exist (see init_paging).
+*/
+void init_buddy();
+
+/*
+  Procedure..: page_reserve
+  Description..: Takes a block of address space from the page
+      region: the smallest power of two of pages that holds the
+      given number, split off a larger free block if it has to
+      be. Nothing is mapped into it. Takes time logarithmic in
+      the size of the region.
+  Params..: pages - the number of pages needed
+  Returns..: the lowest address of the block, or 0 if there is
+      no free block large enough
+*/
+u32int page_reserve(u32int pages);
+
+/*
+  Procedure..: page_alloc
+  Description..: Reserves a block (see page_reserve) and maps
+      fresh frames into as many of its pages as the size needs.
+  Params..: size - the number of bytes needed
+  Returns..: the lowest address of the block, or 0 if there is
+      no free block large enough
+*/
+u32int page_alloc(u32int size);
+
+/*
+  Procedure..: page_free
+  Description..: Unmaps every mapped page of a block made by
+      page_reserve or page_alloc and gives its address space
+      back, merging it with its free buddy, and that block's
+      free buddy, and so on up.
+  Params..: addr - the address the block was made at
+*/
+void page_free(u32int addr);
+
+/*
+  Procedure..: is_page_block
+  Description..: Tells whether an address is the start of a block
+      made by page_reserve or page_alloc and not yet freed.
+*/
+int is_page_block(u32int addr);
+
+/*
+  Procedure..: get_page_region_stats
+  Description..: Reports how much of the page region is free.
+  Params..: free_pages - where to put the number of free pages
+      largest - where to put the pages in the largest free block
+*/
+void get_page_region_stats(u32int *free_pages, u32int *largest);
+
+#endif
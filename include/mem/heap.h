@@ -7,6 +7,11 @@
 #define KHEAP_MIN  0x10000
 #define KHEAP_SIZE 0x1000000
 
+/* Virtual address range the MPX heap (modules/R5) is mapped
+   into, a page at a time as it grows */
+#define MPX_HEAP_BASE 0xC000000
+#define MPX_HEAP_SIZE 0x1000000
+
 /* Heap allocation header */
 typedef struct {
   int size;
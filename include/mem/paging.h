@@ -93,4 +93,12 @@ page_entry* get_page(u32int addr, page_dir *dir, int make_table);
 */
 void new_frame(page_entry* page);
 
+/*
+  Procedure..: free_frame
+  Description..: Unmaps the page at a virtual address, marking
+    its frame as free in the frame bitmap and flushing the
+    page from the TLB.
+*/
+void free_frame(u32int addr, page_dir *dir);
+
 #endif
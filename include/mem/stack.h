@@ -0,0 +1,36 @@
+#ifndef _STACK_H
+#define _STACK_H
+
+#include <system.h>
+
+/*
+  Procedure..: stack_alloc
+  Description..: Maps a new process stack of at least the given
+      size (rounded up to whole pages) with an unmapped guard page
+      directly below it, so overflowing the stack faults instead of
+      running into other memory. The stack and its guard are a
+      block of the page region (see page_reserve). Requires
+      paging to be enabled.
+  Params..: size - the number of bytes the stack needs
+  Returns..: the lowest address of the stack, or 0 if there is
+      no room left in the page region
+*/
+u32int stack_alloc(u32int size);
+
+/*
+  Procedure..: stack_free
+  Description..: Unmaps a stack made by stack_alloc, returning its
+      frames and address range.
+  Params..: base - the address stack_alloc returned
+      size - the size that was passed to stack_alloc
+*/
+void stack_free(u32int base, u32int size);
+
+/*
+  Procedure..: is_stack_guard
+  Description..: Tells whether an address lies in the guard page
+      below one of the stacks.
+*/
+int is_stack_guard(u32int addr);
+
+#endif
@@ -17,6 +17,13 @@ int isspace(const char *c);
 */
 void* memset(void *s, int c, size_t n);
 
+/*
+  Procedure..: memcpy
+  Description..: Copy a region of memory. The regions must not overlap.
+  Params..: s1-destination, s2-source, n-count
+*/
+void* memcpy(void *s1, const void *s2, size_t n);
+
 /*
   Procedure..: strcpy
   Description..: Copy one string to another.
@@ -25,6 +25,7 @@ typedef unsigned int   size_t;
 typedef unsigned char  u8int;
 typedef unsigned short u16int;
 typedef unsigned long  u32int;
+typedef unsigned long long u64int;
 
 /* Time */
 typedef struct {
@@ -48,6 +49,21 @@ static inline int irq_on()
   return f & (1 << 9);
 }
 
+/* Turn irqs off, returning whether they were on beforehand */
+static inline int irq_save()
+{
+  int f = irq_on();
+  cli();
+  return f;
+}
+
+/* Turn irqs back on if they were on before the matching irq_save */
+static inline void irq_restore(int f)
+{
+  if (f)
+    sti();
+}
+
 void klogv(const char *msg);
 void kpanic(const char *msg);
 
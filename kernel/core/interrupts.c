@@ -11,6 +11,7 @@
 #include <core/serial.h>
 #include <core/tables.h>
 #include <core/interrupts.h>
+#include <mem/stack.h>
 
 #include "modules/mpx_supt.h"
 
@@ -99,8 +100,12 @@ void init_irq(void)
     if (i<17) idt_set_gate(i, isrs[i], 0x08, 0x8e);
     else idt_set_gate(i, (u32int)reserved, 0x08, 0x8e);
   }
-  // Ignore interrupts from the real time clock
-  idt_set_gate(0x08, (u32int)rtc_isr, 0x08, 0x8e);
+  // Double faults switch to a task with a stack of its own, so that
+  // one caused by an overflowed stack can still be reported
+  idt_set_gate(0x08, 0, FAULT_TSS_SEL, 0x85);
+
+  // Ignore interrupts from the real time clock (irq8, remapped to 40)
+  idt_set_gate(0x28, (u32int)rtc_isr, 0x08, 0x8e);
 
 }
 
@@ -169,6 +174,38 @@ void do_double_fault()
 {
   kpanic("Double fault");
 }
+
+/*
+  Procedure..: stack_overflow
+  Description..: Reports a process that ran off the bottom of its
+      stack into the guard page, then panics.
+*/
+static void stack_overflow()
+{
+  PCB *pcb = get_running_pcb();
+  if (pcb){
+    klogv("Stack overflow in process:");
+    klogv(pcb->name);
+  }
+  kpanic("Stack overflow (hit the guard page)");
+}
+
+/*
+  Procedure..: double_fault_task
+  Description..: Entry point of the double fault task. A process
+      that overflows into its guard page can't take the page fault
+      on its own stack, which is what turns it into a double fault.
+      The state it was in has been saved in the kernel TSS.
+*/
+void double_fault_task()
+{
+  tss_entry *tss = get_kernel_tss();
+  if (is_stack_guard(tss->esp) || is_stack_guard(tss->esp - 1))
+    stack_overflow();
+  kpanic("Double fault");
+  while (1)
+    hlt();
+}
 void do_coprocessor_segment()
 {
   kpanic("Coprocessor segment error");
@@ -191,6 +228,10 @@ void do_general_protection()
 }
 void do_page_fault()
 {
+  u32int addr;
+  asm volatile ("mov %%cr2,%0": "=r"(addr));
+  if (is_stack_guard(addr))
+    stack_overflow();
   kpanic("Page Fault");
 }
 void do_reserved()
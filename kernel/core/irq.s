@@ -25,6 +25,8 @@
 [GLOBAL coprocessor]
 [GLOBAL rtc_isr]
 [GLOBAL sys_call_isr]
+[GLOBAL timer_isr]
+[GLOBAL serial_isr]
 
 ;; Names of the C handlers
 extern do_divide_error
@@ -45,6 +47,8 @@ extern do_page_fault
 extern do_reserved
 extern do_coprocessor
 extern sys_call
+extern timer_call
+extern first_level_int_handler
 
 ; RTC interrupt handler
 ; Tells the slave PIC to ignore
@@ -131,6 +135,7 @@ sys_call_isr:
 
 	call sys_call
 
+switch_context:
 	mov esp, eax ; Is this order correct?
 
 	pop gs
@@ -140,3 +145,28 @@ sys_call_isr:
 	popa
 
 	iret
+
+;;; Timer (IRQ0) interrupt handler. Saves the interrupted process
+;;; exactly like sys_call_isr so the C handler can preempt it, then
+;;; shares the restore path. timer_call returns the stack top of
+;;; the process to resume (the same one if no switch is needed).
+timer_isr:
+	pusha
+	push ds
+	push es
+	push fs
+	push gs
+	push esp
+
+	call timer_call
+
+	jmp switch_context
+
+;;; Serial port (IRQ4) interrupt handler. The C handler is an
+;;; ordinary function, so it needs a stub that preserves the
+;;; interrupted registers and returns with iret.
+serial_isr:
+	pusha
+	call first_level_int_handler
+	popa
+	iret
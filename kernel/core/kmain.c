@@ -18,13 +18,13 @@
 #include <core/serial.h>
 #include <core/tables.h>
 #include <core/interrupts.h>
+#include <core/timer.h>
 #include <mem/heap.h>
 #include <mem/paging.h>
 
 #include "modules/R1/comhand.h"
 #include "modules/mpx_supt.h"
 #include "modules/R3/loadr3.h"
-#include "modules/R4/idle.h"
 #include "modules/R5/TestR5.h"
 #include "modules/R6/serial_commands.h"
 
@@ -51,9 +51,6 @@ void kmain(void)
    klogv("Starting MPX boot sequence...");
    klogv("Initialized serial I/O on COM1 device...");
 
-   init_heap(50000);
-   klogv("Heap created...");
-
    // 1) Initialize the support software by identifying the current
    //     MPX Module.  This will change with each module.
    // you will need to call mpx_init from the mpx_supt.c
@@ -61,13 +58,6 @@ void kmain(void)
    mpx_init(IO_MODULE);
    mpx_init(MODULE_F);
 
-   sys_set_malloc(allocate_mem);
-   sys_set_free(free_mem);
-
-   if (!is_empty()) {
-      kpanic("Heap is not empty!");
-   }
-   klogv("Mem module successfully initiated...");
  	
    // 2) Check that the boot was successful and correct when using grub
    // Comment this when booting the kernel directly using QEMU, etc.
@@ -100,23 +90,41 @@ void kmain(void)
    klogv("Initializing virtual memory...");
    init_paging();
 
+   // the MPX heap maps its pages into the kernel page directory,
+   // so it can only be created once paging is enabled
+   init_heap(50000, DEFAULT_HEAP_LIMIT);
+   klogv("Heap created...");
+
+   sys_set_malloc(allocate_mem);
+   sys_set_free(free_mem);
+   sys_set_realloc(reallocate_mem);
+
+   if (!is_empty()) {
+      kpanic("Heap is not empty!");
+   }
+   klogv("Mem module successfully initiated...");
+
    // 6) Call YOUR command handler -  interface method
    klogv("Transferring control to commhand...");
 
+   // start the PIT so running processes are preempted once their
+   // time slice (see sys_set_quantum) runs out, and processes left
+   // waiting are aged up in priority (see sys_set_aging)
+   init_timer(TIMER_FREQUENCY);
+   sys_set_quantum(DEFAULT_QUANTUM);
+   sys_set_aging(DEFAULT_AGING_RATE);
+
    static int e_flag = 1;
    init_iocb(&e_flag);
    com_open(&e_flag, 1200);
    
    //startup(); // startup process: splash screen, allocate queues
    allocate_queues();
-   load_proc("main", System, 9, run_comhand); // create main proc
-   load_proc("idle", System, 0, idle_proc); // create idle proc
-   load_proc("secondaryidle", System, 0, idle_proc); // create secondary idle proc
+   load_proc("main", System, 9, run_comhand, 4 * DEFAULT_STACK_SIZE); // create main proc (comhand nests deeply, so give it room)
+   // no idle processes: the dispatcher halts the CPU when nothing is ready
    //load_proc("com_write", User, 5, COMWRITE);
    // load_proc("com_write2", User, 5, COMWRITE);
    resume_pcb("main"); //resume these processes 
-   resume_pcb("idle");
-   resume_pcb("secondaryidle");
    //resume_pcb("com_write");
    // resume_pcb("com_write2");
    asm volatile ("int $60"); // interrupt 60 to context switch into main
@@ -10,7 +10,14 @@
 
 // Global Descriptor Table
 gdt_descriptor gdt_ptr;
-gdt_entry gdt_entries[5];
+gdt_entry gdt_entries[7];
+
+// Task state segments. The kernel runs as a single task; the only
+// task switch is into the double fault task, which gets a stack of
+// its own so a fault caused by an overflowed stack can be reported
+tss_entry kernel_tss;
+tss_entry fault_tss;
+static u8int fault_stack[4096];
 
 // Interrupt Descriptor Table
 idt_descriptor idt_ptr;
@@ -20,6 +27,9 @@ idt_entry idt_entries[256];
 extern void write_gdt_ptr(u32int, size_t);
 extern void write_idt_ptr(u32int);
 
+// Entry point of the double fault task (see interrupts.c)
+extern void double_fault_task();
+
 /*
   Procedure..: idt_set_gate
   Description..: Installs a new gate entry into the IDT.
@@ -81,7 +91,7 @@ void gdt_init_entry(int idx, u32int base, u32int limit,
 */
 void init_gdt()
 {
-  gdt_ptr.limit = 5 * sizeof(gdt_entry) - 1;
+  gdt_ptr.limit = 7 * sizeof(gdt_entry) - 1;
   gdt_ptr.base  = (u32int) gdt_entries;
 
   u32int limit = 0xFFFFFFFF;
@@ -91,5 +101,40 @@ void init_gdt()
   gdt_init_entry(3, 0, limit, 0xFA, 0xCF); //user mode code segment
   gdt_init_entry(4, 0, limit, 0xF2, 0xCF); //user mode data segment
 
+  memset(&kernel_tss, 0, sizeof(tss_entry));
+  memset(&fault_tss, 0, sizeof(tss_entry));
+  fault_tss.eip    = (u32int)double_fault_task;
+  fault_tss.esp    = (u32int)(fault_stack + sizeof(fault_stack));
+  fault_tss.eflags = 0x2; //interrupts stay off
+  fault_tss.cs     = 0x08;
+  fault_tss.ds = fault_tss.es = fault_tss.fs = fault_tss.gs = fault_tss.ss = 0x10;
+  kernel_tss.iomap_base = fault_tss.iomap_base = sizeof(tss_entry);
+
+  gdt_init_entry(5, (u32int)&kernel_tss, sizeof(tss_entry) - 1, 0x89, 0x00); //kernel task
+  gdt_init_entry(6, (u32int)&fault_tss, sizeof(tss_entry) - 1, 0x89, 0x00);  //double fault task
+
   write_gdt_ptr((u32int) &gdt_ptr, sizeof(gdt_ptr));
+
+  //the CPU saves the interrupted state here when it switches to the fault task
+  asm volatile ("ltr %%ax":: "a"(KERNEL_TSS_SEL));
+}
+
+/*
+  Procedure..: get_kernel_tss
+  Description..: Returns the kernel task state segment, which holds
+      the state the double fault task interrupted.
+*/
+tss_entry* get_kernel_tss()
+{
+  return &kernel_tss;
+}
+
+/*
+  Procedure..: set_fault_tss_cr3
+  Description..: Sets the page directory the double fault task
+      runs with. Must be kept in step with the one loaded in cr3.
+*/
+void set_fault_tss_cr3(u32int cr3)
+{
+  fault_tss.cr3 = cr3;
 }
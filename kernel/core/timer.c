@@ -0,0 +1,124 @@
+/*
+  ----- timer.c -----
+
+  Description..: Programmable interval timer (8253/8254) setup
+      and the system tick counter.
+*/
+
+#include <system.h>
+
+#include <core/io.h>
+#include <core/tables.h>
+#include <core/timer.h>
+#include <core/tsc.h>
+
+// PIT ports
+#define PIT_CHANNEL0 0x40
+#define PIT_COMMAND  0x43
+
+// Channel 0, lobyte/hibyte access, mode 3 (square wave), binary
+#define PIT_MODE 0x36
+
+// Input clock of the PIT in Hz
+#define PIT_BASE_FREQUENCY 1193182
+
+// IRQ0 is remapped to vector 32 by init_pic
+#define TIMER_VECTOR 0x20
+
+extern void timer_isr();
+
+static volatile u32int ticks = 0;
+static u64int boot_tsc = 0; // time stamp counter when the timer was started
+
+/*
+  Procedure..: init_timer
+  Description..: Programs channel 0 of the programmable interval
+      timer to fire at the given frequency, installs the IRQ0
+      handler and unmasks IRQ0 on the master PIC.
+*/
+void init_timer(u32int frequency)
+{
+  u32int divisor = PIT_BASE_FREQUENCY / frequency;
+
+  idt_set_gate(TIMER_VECTOR, (u32int)timer_isr, 0x08, 0x8e);
+
+  outb(PIT_COMMAND, PIT_MODE);
+  outb(PIT_CHANNEL0, divisor & 0xFF);
+  outb(PIT_CHANNEL0, (divisor >> 8) & 0xFF);
+
+  boot_tsc = rdtsc();
+  outb(0x21, inb(0x21) & ~0x01); //unmask irq0
+}
+
+/*
+  Procedure..: timer_tick
+  Description..: Advances the tick counter. Called once per IRQ0.
+*/
+void timer_tick(void)
+{
+  ticks++;
+}
+
+/*
+  Procedure..: get_ticks
+  Description..: Returns the number of timer interrupts since boot.
+*/
+u32int get_ticks(void)
+{
+  return ticks;
+}
+
+/*
+  Procedure..: ms_to_ticks
+  Description..: Converts milliseconds into timer ticks, rounding up.
+*/
+u32int ms_to_ticks(u32int ms)
+{
+  u32int ms_per_tick = 1000 / TIMER_FREQUENCY;
+  return ms / ms_per_tick + (ms % ms_per_tick != 0);
+}
+
+/*
+  Procedure..: cycles_per_ms
+  Description..: Measures the CPU clock against the timer: the
+      cycles counted since init_timer divided by the milliseconds
+      the timer has counted. Returns 0 until the first tick.
+*/
+static u32int cycles_per_ms(void)
+{
+  u32int elapsed = ticks;
+  if (elapsed == 0)
+    return 0;
+
+  u64int per_ms = div64(rdtsc() - boot_tsc, elapsed * (1000 / TIMER_FREQUENCY));
+  if (per_ms >> 32) // keep the divisor in 32 bits
+    per_ms = 0xFFFFFFFF;
+  return (u32int)per_ms;
+}
+
+/*
+  Procedure..: cycles_to_ms
+  Description..: Converts a count of CPU cycles into milliseconds,
+      using the cycle rate measured against the timer since
+      init_timer. Returns 0 until the first tick has been seen.
+*/
+u32int cycles_to_ms(u64int cycles)
+{
+  u32int per_ms = cycles_per_ms();
+  if (per_ms == 0)
+    return 0;
+  return (u32int)div64(cycles, per_ms);
+}
+
+/*
+  Procedure..: cycles_to_us
+  Description..: Converts a count of CPU cycles into microseconds,
+      the same way as cycles_to_ms.
+*/
+u32int cycles_to_us(u64int cycles)
+{
+  u32int per_ms = cycles_per_ms();
+  if (per_ms == 0)
+    return 0;
+  return (u32int)div64(cycles * 1000, per_ms);
+}
@@ -0,0 +1,206 @@
+/*
+  ----- buddy.c -----
+
+  Description..: Binary buddy allocator over the page region.
+    Every block is a power of two of pages, aligned to its own
+    size, so the block it was split from (and merges back into)
+    is found by flipping a single bit of its page number. The
+    region's pages aren't mapped until a block is made, so the
+    allocator's own state is kept in tables here, one entry per
+    page of the region, rather than in the free blocks.
+*/
+
+#include <system.h>
+#include <string.h>
+
+#include <mem/paging.h>
+#include <mem/buddy.h>
+
+#define NO_BLOCK 0xFFFF
+
+extern page_dir *kdir; //kernel page directory
+
+static u16int free_lists[BUDDY_ORDERS]; //first free block of each order
+static u32int nonempty; //bit k is set while free_lists[k] has a block
+static u16int next_free[PAGE_REGION_PAGES]; //links of the free lists
+static u16int prev_free[PAGE_REGION_PAGES];
+static u8int block_order[PAGE_REGION_PAGES]; //order of the block that starts at a page
+static u32int free_heads[PAGE_REGION_PAGES / 32]; //pages that start a free block
+static u32int used_heads[PAGE_REGION_PAGES / 32]; //pages that start a block in use
+static u32int pages_free;
+
+#define PAGE_BIT(map, page) ((map)[(page) / 32] & (1 << ((page) % 32)))
+#define SET_PAGE(map, page) ((map)[(page) / 32] |= (1 << ((page) % 32)))
+#define CLEAR_PAGE(map, page) ((map)[(page) / 32] &= ~(1 << ((page) % 32)))
+
+/*
+  Procedure..: push_block
+  Description..: Puts a block on the free list of its order.
+*/
+static void push_block(u32int page, u32int order)
+{
+  block_order[page] = order;
+  prev_free[page] = NO_BLOCK;
+  next_free[page] = free_lists[order];
+  if (free_lists[order] != NO_BLOCK)
+    prev_free[free_lists[order]] = page;
+  free_lists[order] = page;
+  nonempty |= 1 << order;
+  SET_PAGE(free_heads, page);
+}
+
+/*
+  Procedure..: remove_block
+  Description..: Takes a block off the free list of its order.
+*/
+static void remove_block(u32int page)
+{
+  u32int order = block_order[page];
+  if (next_free[page] != NO_BLOCK)
+    prev_free[next_free[page]] = prev_free[page];
+  if (prev_free[page] != NO_BLOCK)
+    next_free[prev_free[page]] = next_free[page];
+  else {
+    free_lists[order] = next_free[page];
+    if (free_lists[order] == NO_BLOCK)
+      nonempty &= ~(1 << order);
+  }
+  CLEAR_PAGE(free_heads, page);
+}
+
+/*
+  Procedure..: init_buddy
+  Description..: Makes the whole page region one free block.
+*/
+void init_buddy()
+{
+  u32int order;
+  for (order = 0; order < BUDDY_ORDERS; order++)
+    free_lists[order] = NO_BLOCK;
+  nonempty = 0;
+  memset(free_heads, 0, sizeof(free_heads));
+  memset(used_heads, 0, sizeof(used_heads));
+
+  push_block(0, BUDDY_ORDERS - 1);
+  pages_free = PAGE_REGION_PAGES;
+}
+
+/*
+  Procedure..: page_reserve
+  Description..: Takes the smallest block of at least the given
+      number of pages, splitting a larger one if it has to.
+*/
+u32int page_reserve(u32int pages)
+{
+  u32int order = 0;
+  if (pages > PAGE_REGION_PAGES)
+    return 0;
+  while ((1u << order) < pages)
+    order++;
+
+  int irqs = irq_save();
+  u32int fits = nonempty & ~((1u << order) - 1);
+  if (fits == 0){
+    irq_restore(irqs);
+    return 0;
+  }
+
+  //the smallest free block that fits, halved until it is the right size
+  u32int split = __builtin_ctz(fits);
+  u32int page = free_lists[split];
+  remove_block(page);
+  while (split > order){
+    split--;
+    push_block(page + (1 << split), split);
+  }
+  block_order[page] = order;
+  SET_PAGE(used_heads, page);
+  pages_free -= 1 << order;
+  irq_restore(irqs);
+
+  return PAGE_REGION_BASE + page * PAGE_SIZE;
+}
+
+/*
+  Procedure..: page_alloc
+  Description..: Reserves a block and maps the pages the size
+      needs.
+*/
+u32int page_alloc(u32int size)
+{
+  u32int pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+  u32int i;
+  if (pages == 0)
+    pages = 1;
+
+  u32int base = page_reserve(pages);
+  if (base == 0)
+    return 0;
+
+  int irqs = irq_save();
+  for (i = 0; i < pages; i++)
+    new_frame(get_page(base + i * PAGE_SIZE, kdir, 0));
+  irq_restore(irqs);
+
+  return base;
+}
+
+/*
+  Procedure..: page_free
+  Description..: Unmaps a block and merges it back into the free
+      blocks.
+*/
+void page_free(u32int addr)
+{
+  int irqs = irq_save();
+  if (!is_page_block(addr)){
+    irq_restore(irqs);
+    return;
+  }
+
+  u32int page = (addr - PAGE_REGION_BASE) / PAGE_SIZE;
+  u32int order = block_order[page];
+  u32int i;
+  for (i = 0; i < (1u << order); i++)
+    free_frame(addr + i * PAGE_SIZE, kdir); //pages that were never mapped are skipped
+  CLEAR_PAGE(used_heads, page);
+  pages_free += 1 << order;
+
+  //merge with the buddy for as long as it is free and whole
+  while (order < BUDDY_ORDERS - 1){
+    u32int buddy = page ^ (1 << order);
+    if (!PAGE_BIT(free_heads, buddy) || block_order[buddy] != order)
+      break;
+    remove_block(buddy);
+    page &= ~(1 << order);
+    order++;
+  }
+  push_block(page, order);
+  irq_restore(irqs);
+}
+
+/*
+  Procedure..: is_page_block
+  Description..: Tells whether an address starts a block in use.
+*/
+int is_page_block(u32int addr)
+{
+  if (addr < PAGE_REGION_BASE || addr >= PAGE_REGION_BASE + PAGE_REGION_SIZE
+      || addr % PAGE_SIZE != 0)
+    return 0;
+  return PAGE_BIT(used_heads, (addr - PAGE_REGION_BASE) / PAGE_SIZE) != 0;
+}
+
+/*
+  Procedure..: get_page_region_stats
+  Description..: Reports how much of the page region is free.
+*/
+void get_page_region_stats(u32int *free_pages, u32int *largest)
+{
+  int irqs = irq_save();
+  *free_pages = pages_free;
+  *largest = 0;
+  if (nonempty != 0)
+    *largest = 1 << (31 - __builtin_clz(nonempty));
+  irq_restore(irqs);
+}
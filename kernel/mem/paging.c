@@ -11,6 +11,8 @@
 
 #include "mem/heap.h"
 #include "mem/paging.h"
+#include "mem/buddy.h"
+#include "core/tables.h"
 
 u32int mem_size  = 0x4000000; //64MB
 u32int page_size = 0x1000; //4KB
@@ -112,8 +114,8 @@ void init_paging()
 {
   //create frame bitmap
   nframes = (u32int)(mem_size/page_size);
-  frames = (u32int*)kmalloc(nframes/32);
-  memset(frames, 0, nframes/32);
+  frames = (u32int*)kmalloc(nframes/8);
+  memset(frames, 0, nframes/8);
 
   //create kernel directory
   kdir = (page_dir*)_kmalloc(sizeof(page_dir), 1, 0); //page aligned
@@ -125,6 +127,19 @@ void init_paging()
     get_page(i,kdir,1);
   }
 
+  //make the page tables for blocks of whole pages (stacks, large
+  //heap blocks) now, while page tables can still come from
+  //(identity mapped) placement memory
+  for(i=PAGE_REGION_BASE; i<(PAGE_REGION_BASE+PAGE_REGION_SIZE); i+=PAGE_SIZE*1024){
+    get_page(i,kdir,1);
+  }
+  init_buddy();
+
+  //and for the MPX heap, which maps pages into its region as it grows
+  for(i=MPX_HEAP_BASE; i<(MPX_HEAP_BASE+MPX_HEAP_SIZE); i+=PAGE_SIZE*1024){
+    get_page(i,kdir,1);
+  }
+
   //perform identity mapping of used memory
   //note: placement_addr gets incremented in get_page,
   //so we're mapping the first frames as well
@@ -158,6 +173,7 @@ void init_paging()
 void load_page_dir(page_dir *new_dir)
 {
   cdir = new_dir;
+  set_fault_tss_cr3((u32int)&cdir->tables_phys[0]); //the fault task switches cr3 too
   asm volatile ("mov %0,%%cr3":: "b"(&cdir->tables_phys[0]));
   u32int cr0;
   asm volatile ("mov %%cr0,%0": "=b"(cr0));
@@ -183,3 +199,20 @@ void new_frame(page_entry *page)
   page->writeable = 1;
   page->usermode  = 0;
 }
+
+/*
+  Procedure..: free_frame
+  Description..: Unmaps the page at a virtual address, marking
+    its frame as free in the frame bitmap and flushing the
+    page from the TLB.
+*/
+void free_frame(u32int addr, page_dir *dir)
+{
+  page_entry *page = get_page(addr, dir, 0);
+  if (!page || !page->present) return;
+
+  clear_bit(page->frameaddr*page_size);
+  page->present   = 0;
+  page->frameaddr = 0;
+  asm volatile ("invlpg (%0)":: "r"(addr) : "memory");
+}
@@ -0,0 +1,78 @@
+/*
+  ----- stack.c -----
+
+  Description..: Page-granular process stacks. Each stack is a
+    block of the page region (see buddy.c), with the lowest page
+    of the block left unmapped as a guard.
+*/
+
+#include <system.h>
+#include <string.h>
+
+#include <mem/paging.h>
+#include <mem/buddy.h>
+#include <mem/stack.h>
+
+extern page_dir *kdir; //kernel page directory
+
+static u32int guards[PAGE_REGION_PAGES / 32]; //pages of the region that are guards
+
+#define PAGE_BIT(map, page) ((map)[(page) / 32] & (1 << ((page) % 32)))
+#define SET_PAGE(map, page) ((map)[(page) / 32] |= (1 << ((page) % 32)))
+#define CLEAR_PAGE(map, page) ((map)[(page) / 32] &= ~(1 << ((page) % 32)))
+
+/*
+  Procedure..: stack_alloc
+  Description..: Maps a new process stack with an unmapped guard
+      page below it.
+*/
+u32int stack_alloc(u32int size)
+{
+  u32int pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+  u32int i;
+  if (pages == 0)
+    pages = 1;
+
+  int irqs = irq_save();
+  u32int block = page_reserve(pages + 1);
+  if (block == 0){
+    irq_restore(irqs);
+    return 0;
+  }
+
+  // the first page stays unmapped; it is the guard
+  SET_PAGE(guards, (block - PAGE_REGION_BASE) / PAGE_SIZE);
+
+  u32int base = block + PAGE_SIZE;
+  for (i = 0; i < pages; i++)
+    new_frame(get_page(base + i * PAGE_SIZE, kdir, 0));
+  irq_restore(irqs);
+
+  return base;
+}
+
+/*
+  Procedure..: stack_free
+  Description..: Unmaps a stack made by stack_alloc.
+*/
+void stack_free(u32int base, u32int size)
+{
+  u32int block = base - PAGE_SIZE;
+  no_warn(size); // the block remembers its own size
+
+  int irqs = irq_save();
+  CLEAR_PAGE(guards, (block - PAGE_REGION_BASE) / PAGE_SIZE);
+  page_free(block);
+  irq_restore(irqs);
+}
+
+/*
+  Procedure..: is_stack_guard
+  Description..: Tells whether an address lies in a guard page.
+*/
+int is_stack_guard(u32int addr)
+{
+  if (addr < PAGE_REGION_BASE || addr >= PAGE_REGION_BASE + PAGE_REGION_SIZE)
+    return 0;
+  return PAGE_BIT(guards, (addr - PAGE_REGION_BASE) / PAGE_SIZE) != 0;
+}
@@ -143,6 +143,21 @@ void* memset(void *s, int c, size_t n)
   return s;
 }
 
+/*
+  Procedure..: memcpy
+  Description..: Copy a region of memory. The regions must not overlap.
+  Params..: s1-destination, s2-source, n-count
+*/
+void* memcpy(void *s1, const void *s2, size_t n)
+{
+  unsigned char *d = (unsigned char *) s1;
+  const unsigned char *s = (const unsigned char *) s2;
+  while(n--){
+    *d++ = *s++;
+  }
+  return s1;
+}
+
 /*
   Procedure..: strtok
   Description..: Split string into tokens
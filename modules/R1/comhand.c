@@ -1,9 +1,14 @@
 #include "comhand.h"
 #include "../R2/PCB.h"
 #include "../R2/Queue.h"
+#include "../R2/Top.h"
 #include "../R3/loadr3.h"
+#include "../R3/trace.h"
+#include "../R3/bench.h"
 #include "../R4/alarm.h"
+#include "../R4/timer_wheel.h"
 #include "../R5/TestR5.h"
+#include "../R5/slab.h"
 
 //The following constants describe commands that the user has the option to run
 #define VERSION "version"
@@ -39,10 +44,18 @@
 #define SHOWALL_PCB "all"
 #define SHOWREADY_PCB "ready"
 #define SHOWBLOCKED_PCB "blocked"
+#define STACKS_PCB "stacks"
+#define STATS_PCB "stats"
+#define TOP "top"
 
 //R3 commands
 #define LOADR3 "loadr3"
 
+#define BENCH "bench"
+#define TRACE "trace"
+#define TRACE_DUMP "dump"
+#define TRACE_CLEAR "clear"
+
 //R4 commands
 #define ALARM "alarm"
 
@@ -50,6 +63,10 @@
 #define MEM "mem"
 #define SHOW_ALLOCATED "showallocated"
 #define SHOW_FREE "showfree"
+#define CACHES "caches"
+#define MEM_STATS "stats"
+#define MEM_SHOW "show"
+#define MEM_OWNER "owner"
 
 enum pcb_func {Suspend, Resume, Priority, Show};
 
@@ -59,7 +76,9 @@ void date_logic(char*);
 void time_logic(char*);
 void pcb_logic(char*);
 void pcb_parsing(char*, enum pcb_func);
+int stats_option(char*);
 void mem_logic(char*);
+void mem_owner_logic(char*);
 
 /**
  * The startup function is executed before comhand. It clears the screen, outputs the amogus
@@ -119,8 +138,10 @@ void shutdown() {
                                          *\n\
     *\n");*/
 
-    Queue* readyQueue = getReadyQueue();
-    readyQueue->head = NULL;
+    // drop every other process so nothing is left to dispatch once main exits
+    empty_queue(getReadyQueue());
+    empty_queue(getBlockedQueue());
+    clear_timer_wheel();
 
 	sys_req(EXIT, DEFAULT_DEVICE, NULL, NULL);
 }
@@ -380,6 +401,24 @@ void run_comhand() {
 	    else if(are_equal(command, PCB))
 	        pcb_logic(cmdBuffer);
 
+	    else if (are_equal(command, TOP)) {
+	    	advance_pointer(cmdBuffer);
+	    	if (rest_empty(cmdBuffer)) {
+	    		int refresh = 1;
+	    		while (refresh) {
+	    			show_top();
+	    			println("\n Press enter to refresh, or type anything else to return");
+
+	    			memset(cmdBuffer, '\0', BUFFER_SIZE);
+	    			bufferSize = 100;
+	    			sys_req(READ, DEFAULT_DEVICE, cmdBuffer, &bufferSize);
+	    			refresh = rest_empty(cmdBuffer);
+	    		}
+	    	} else {
+	    		println("\n Invalid option for top command");
+	    	}
+	    }
+
 	    else if (are_equal(command, LOADR3)) {
 	    	advance_pointer(cmdBuffer);
 	    	println("");
@@ -391,6 +430,33 @@ void run_comhand() {
 	    	}
 	    }
 
+	    else if (are_equal(command, BENCH)) {
+	    	advance_pointer(cmdBuffer);
+	    	if (rest_empty(cmdBuffer))
+	    		run_bench();
+	    	else
+	    		println("\n Invalid option for bench command");
+	    }
+
+	    else if (are_equal(command, TRACE)) {
+	    	advance_pointer(cmdBuffer);
+	    	trim_front(cmdBuffer);
+	    	command[0] = '\0';
+	    	get_command(cmdBuffer, command);
+	    	advance_pointer(cmdBuffer);
+
+	    	if (!rest_empty(cmdBuffer))
+	    		println("\n Invalid option for trace command");
+	    	else if (are_equal(command, TRACE_DUMP))
+	    		trace_dump();
+	    	else if (are_equal(command, TRACE_CLEAR)) {
+	    		trace_clear();
+	    		println("\n Cleared the dispatch trace");
+	    	}
+	    	else
+	    		println("\n The trace command takes either dump or clear");
+	    }
+
 	    else if (are_equal(command, ALARM)) {
 	    	advance_pointer(cmdBuffer);
 	    	if (rest_empty(cmdBuffer)) {
@@ -604,6 +670,10 @@ void pcb_logic(char* cmdBuffer)
 			{
 				show_ready();
 			}
+			else if(stats_option(cmdBuffer))
+			{
+				show_ready_stats();
+			}
 			else
 				println("\nInvalid input for PCB command");
 		}
@@ -614,6 +684,20 @@ void pcb_logic(char* cmdBuffer)
 			{
 				show_blocked();
 			}
+			else if(stats_option(cmdBuffer))
+			{
+				show_blocked_stats();
+			}
+			else
+				println("\nInvalid input for PCB command");
+		}
+		else if(are_equal(command, STACKS_PCB))
+		{
+			advance_pointer(cmdBuffer);
+			if(rest_empty(cmdBuffer))
+			{
+				show_stacks();
+			}
 			else
 				println("\nInvalid input for PCB command");
 		}
@@ -624,6 +708,22 @@ void pcb_logic(char* cmdBuffer)
 	}
 }
 
+/**
+ * This function is a helper method for pcb_logic(). It checks whether the rest of a "pcb ready"
+ * or "pcb blocked" command asks for the statistics of the queues rather than their contents.
+ * 
+ * @param cmdBuffer - the rest of the command, after "ready" or "blocked"
+ * @return 1 if it is exactly "stats", 0 otherwise
+*/
+int stats_option(char* cmdBuffer)
+{
+	trim_front(cmdBuffer);
+	char option[100];
+	get_command(cmdBuffer, option);
+	advance_pointer(cmdBuffer);
+	return are_equal(option, STATS_PCB) && rest_empty(cmdBuffer);
+}
+
 /**
  * This function is a helper method for pcb_logic(). This function receives a command string
  * which includes the name of the PCB to perform an operation on, as well as any additional
@@ -766,9 +866,54 @@ void mem_logic(char* cmdBuffer) {
 		{
 			show_cmcbs(Free);
 		}
+		else if(are_equal(command, CACHES))
+		{
+			show_caches();
+		}
+		else if(are_equal(command, MEM_STATS))
+		{
+			show_heap_stats();
+		}
+		else if(are_equal(command, MEM_SHOW))
+		{
+			mem_owner_logic(cmdBuffer);
+		}
 		else
 		{
 			println("\nInvalid input for mem command");
 		}
 	}
+}
+
+/**
+ * This function is a helper method for mem_logic(). It handles "mem show owner <name>", which lists
+ * the heap blocks owned by the named process.
+ * 
+ * @param cmdBuffer - a command beginning with "mem show"
+*/
+void mem_owner_logic(char* cmdBuffer)
+{
+	advance_pointer(cmdBuffer);
+	trim_front(cmdBuffer);
+
+	char option[100];
+	get_command(cmdBuffer, option);
+	advance_pointer(cmdBuffer);
+	if(!are_equal(option, MEM_OWNER) || rest_empty(cmdBuffer))
+	{
+		println("\nIncorrect format for mem show command");
+		return;
+	}
+
+	trim_front(cmdBuffer);
+	char name[100];
+	get_command(cmdBuffer, name);
+	advance_pointer(cmdBuffer);
+	if(!rest_empty(cmdBuffer))
+	{
+		println("\nNames for PCBs cannot include spaces");
+		return;
+	}
+
+	show_owned_mem(name);
 }
\ No newline at end of file
@@ -62,14 +62,33 @@ void help(char command[]){
 		println(" pcb resume [name] - unsuspends the PCB with the given name");
 		println(" pcb resumeall - unsuspends all PCBs");
 		println(" pcb priority [name] [0-9] - changes the priority of the PCB with the given name to the input number (from 0-9)");
-		println(" pcb show [name] - displays the PCB with the given name to the screen");
+		println(" pcb show [name] - displays the PCB with the given name to the screen, including its stack use");
 		println(" pcb all - displays all processes to the screen (same as first command)");
 		println(" pcb ready - displays all ready processes to the screen");
+		println(" pcb ready stats - displays the length of the ready queues and how long processes waited in them");
 		println(" pcb blocked - displays all blocked processes to the screen");
+		println(" pcb blocked stats - displays the length of the blocked queues and how long processes stayed in them");
+		println(" pcb stacks - displays how much of its stack each process has used, and the deepest use by any exited process");
+	}
+	else if (strcmp(command, "top") == 0) {
+		println("Lists every process, busiest first, with its share of the CPU since the last refresh,");
+		println(" its total CPU time and how many times it has been dispatched, has given up the CPU");
+		println(" (VOL) and has been preempted by the timer (INVOL). Press enter to refresh.");
 	}
 	else if (strcmp(command, "loadr3") == 0) {
 		println("Loads the five R3 processes (puts them in a suspended ready state)");
 	}
+	else if (strcmp(command, "bench") == 0) {
+		println("Measures the cost of a yield with nothing else ready, and of a round trip between");
+		println(" two processes that yield to each other, in CPU cycles. Other ready processes");
+		println(" take part in the round trips, so suspend them first for clean numbers.");
+	}
+	else if (strcmp(command, "trace") == 0) {
+		println("The dispatch trace records the last 256 passes through the dispatcher");
+		println(" trace dump - displays each record: when it happened, the request (or PREEMPT),");
+		println("  the process that left the CPU, the one dispatched and the ready queue depth");
+		println(" trace clear - empties the trace");
+	}
 	else if (strcmp(command, "alarm") == 0) {
 		println("alarm [hour]:[minute]:[second] [message]");
 	}
@@ -81,6 +100,9 @@ void help(char command[]){
 		// println("\tmem isempty - shows whether the heap is empty (contains only free memory)");
 		println(" mem showallocated - displays the blocks of allocated memory in the heap");
 		println(" mem showfree - displays the blocks of free memory in the heap");
+		println(" mem caches - displays the object caches (PCBs, IO requests, ...) and their usage");
+		println(" mem stats - displays how much of the heap is used and free, how fragmented it is and how many allocations there have been");
+		println(" mem show owner [name] - displays the blocks of memory the named process has allocated and not freed");
 	}
 	else{
 		print("Command \"");
@@ -108,7 +130,10 @@ void help_for_help() {
 	println("- shutdown");
 	println("- crewmate");
 	println("- pcb");
+	println("- top");
 	println("- loadr3");
+	println("- bench");
+	println("- trace");
 	println("- alarm");
 	println("- mem");
 	println("Use \"help [command]\" for more info on a particular command.");
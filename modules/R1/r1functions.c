@@ -92,6 +92,40 @@ void print_int(int value) {
     print(str);
 }
 
+/**
+ * This function prints a string left-justified in a column of the given width, for tables. The
+ * padded cell is built first and printed in one write, since every write is a system call.
+ * 
+ * @param str - the string to print
+ * @param width - the width of the column, 0 for none (the last column of a row)
+*/
+void print_column(char* str, int width) {
+    char cell[COLUMN_MAX + 1];
+    int len = strlen(str);
+    if (len > COLUMN_MAX) {
+        print(str); // already wider than any column
+        return;
+    }
+
+    strcpy(cell, str);
+    while (len < width && len < COLUMN_MAX)
+        cell[len++] = ' ';
+    cell[len] = '\0';
+    print(cell);
+}
+
+/**
+ * This function prints a number left-justified in a column of the given width, for tables
+ * 
+ * @param value - the number to print
+ * @param width - the width of the column, 0 for none (the last column of a row)
+*/
+void print_int_column(u32int value, int width) {
+    char str[12];
+    bad_itoa(str, (int)value);
+    print_column(str, width);
+}
+
 
 /**
  * This function prints the input string of characters in the current color, followed by a new line character
@@ -1,8 +1,12 @@
 
 #include "../../modules/mpx_supt.h"
 
+#define COLUMN_MAX 40 ///< widest column print_column() pads; wider ones are padded to this
+
 void print(char* buffer);
 void print_int(int value);
+void print_column(char* str, int width);
+void print_int_column(u32int value, int width);
 void println(char* buffer);
 void printColor(char* buffer);
 void changeColor(int new_color);
@@ -1,9 +1,21 @@
 #include "PCB.h"
+#include "PCBTable.h"
+#include "../R4/timer_wheel.h"
 #include "../R1/r1functions.h"
 #include "../mpx_supt.h"
 #include <string.h>
+#include <core/timer.h>
+#include <core/tsc.h>
+#include <mem/stack.h>
+#include <mem/paging.h>
+#include <mem/buddy.h>
+#include "../R5/slab.h"
+#include "../R5/TestR5.h"
+#include "../R6/io_scheduler.h"
 
 void internal_show_pcb(PCB*);
+static void snapshot_pcb(PCB* pcb, PCB* copy, u32int* used);
+static void print_pcb(PCB* pcb, u32int used);
 
 
 
@@ -14,6 +26,14 @@ static Queue* suspendedReadyQueue;
 static Queue* suspendedBlockedQueue;
 // static PCB* runningPCB;
 
+static Cache pcb_cache = CACHE_INIT("pcb", PCB, NULL); /// where PCBs are allocated from
+
+static u32int stacks_measured = 0; /// number of exited processes whose stack use was recorded
+static u32int stack_bytes_used = 0; /// total of their deepest stack use, for the average
+static u32int deepest_used = 0; /// deepest stack use of any exited process
+static u32int deepest_size = 0; /// stack size of that process
+static char deepest_name[21]; /// name of that process
+
 Queue* getReadyQueue(){
 	return readyQueue;
 }
@@ -23,18 +43,13 @@ Queue* getBlockedQueue(){
 }
 
 /**
+ * This function determines whether the process with the given name is a System process
  * 
+ * @param name - the name of the process to check
+ * @return 1 if the process exists and is a System process, 0 otherwise
 */
 int is_system_proc(char* name) {
-	PCB* pcb = NULL;
-
-	switch(findPCB(name)) {
-		case ReadyQ:      pcb = getPCB(readyQueue, name);            break;
-		case BlockedQ:    pcb = getPCB(blockedQueue, name);          break;
-		case SusReadyQ:   pcb = getPCB(suspendedReadyQueue, name);   break;
-		case SusBlockedQ: pcb = getPCB(suspendedBlockedQueue, name); break;
-		default: break;
-	}
+	PCB* pcb = lookup_pcb(name);
 
 	if (pcb != NULL && pcb->type == System)
 		return 1;
@@ -83,31 +98,67 @@ void show_blocked() {
 	printQueue(suspendedBlockedQueue);
 }
 
+/**
+ * This function prints the statistics of the ready and suspended ready queues (see
+ * print_queue_stats()). For the ready queue, the time in the queue is how long processes
+ * waited to be dispatched.
+*/
+void show_ready_stats() {
+	println("\nReady Queue");
+	print_queue_stats(readyQueue);
+	println("\nSuspended Ready Queue");
+	print_queue_stats(suspendedReadyQueue);
+}
 
 /**
- * This method allocates memory for a PCB using sys_alloc_mem from mpx_supt.c.
+ * This function prints the statistics of the blocked and suspended blocked queues (see
+ * print_queue_stats()).
+*/
+void show_blocked_stats() {
+	println("\nBlocked Queue");
+	print_queue_stats(blockedQueue);
+	println("\nSuspended Blocked Queue");
+	print_queue_stats(suspendedBlockedQueue);
+}
+
+
+/**
+ * This method allocates memory for a PCB from the PCB cache (see slab.c).
  * 	See doc for free_pcb().
  * 
  * @return A pointer to the allocated PCB if successful or NULL if not successful
 */
 PCB* allocate_pcb() {
-	PCB* newPCB = sys_alloc_mem(sizeof(PCB));
-	if (newPCB)
-		return newPCB;
-	else 
-		return NULL;
+	return cache_alloc(&pcb_cache);
 }
 
 /**
- * This method frees memory of a PCB. At the moment, it just calls sys_free_mem()
- * 	because all that allocate_pcb() does is call sys_alloc_mem(). It's possible that I
- * 	may need to actually allocate dynamic memory for the stack, but I'm not 100% sure on 
- *  that. If that is the case, this and allocate_pcb() will become a bit more complex
+ * This method frees the memory of a PCB: the heap blocks the process left allocated (see
+ * free_owned_mem()), its stack, which is unmapped (see stack_free()), and the PCB itself, which
+ * goes back to the PCB cache. How deep the stack was used is added to the summary printed by
+ * show_stacks() first.
  * 
  * @return a status code reflective of success/failure
 */
 int free_pcb(PCB* pcb) {
-	return sys_free_mem(pcb);
+	free_owned_mem(pcb);
+	if ((*pcb).stack_base != NULL) {
+		u32int used = stack_used(pcb);
+
+		int irqs = irq_save(); // processes are freed both by commands and by the dispatcher
+		stacks_measured++;
+		stack_bytes_used += used;
+		if (used >= deepest_used) {
+			deepest_used = used;
+			deepest_size = (*pcb).stack_size;
+			strcpy(deepest_name, (*pcb).name);
+		}
+		irq_restore(irqs);
+
+		stack_free((u32int)(*pcb).stack_base, (*pcb).stack_size);
+	}
+	cache_free(&pcb_cache, pcb);
+	return 1;
 }
 
 
@@ -120,12 +171,13 @@ int free_pcb(PCB* pcb) {
  * @param name - a name to give to the newly created PCB
  * @param type - the type of process to create, either User or System
  * @param priority - the priority to give to the PCB
+ * @param stack_size - the size of the process's stack in bytes (rounded up to whole pages)
  * 
  * @return returns 0 if there is an error, and 1 otherwise
 */
-PCB* create_pcb(char* name, enum proc_types type, int priority) {
+PCB* create_pcb(char* name, enum proc_types type, int priority, u32int stack_size) {
 
-	if(findPCB(name) != NoneQ)
+	if(lookup_pcb(name) != NULL)
 	{
 		print("\nA PCB named \"");
 		print(name);
@@ -133,7 +185,10 @@ PCB* create_pcb(char* name, enum proc_types type, int priority) {
 		return NULL;
 	}
 
-	PCB* newPCB = setup_pcb(name, type, priority);
+	PCB* newPCB = setup_pcb(name, type, priority, stack_size);
+	if (newPCB == NULL)
+		return NULL;
+	index_pcb(newPCB);
 	enqueuePCB(readyQueue, newPCB, 0);
 
 	//print("\nPCB Created:");
@@ -142,40 +197,79 @@ PCB* create_pcb(char* name, enum proc_types type, int priority) {
 }
 
 /**
- * This function deletes the PCB with the given name. It must first determine which of the four queues
- * the PCB with the given name is currently located using the findPCB() function. It then removes the
- * PCB from that queue using the delete_pcb_helper() function in the Queue.c file.
+ * This function deletes the PCB with the given name. The PCB is found through the name index,
+ * unlinked from whichever of the four queues it is in, and dropped from the name index. A process
+ * with I/O outstanding is left alone (see delete_pcb_ptr()).
  * 
  * @param name - the name of the process to delete from the system
 */
 void delete_pcb(char name[21])
 {
-	switch(findPCB(name))
+	PCB* deletedPCB = lookup_pcb(name);
+	if (deletedPCB == NULL || (*deletedPCB).queue == NULL)
 	{
-		case ReadyQ:
-			delete_pcb_helper(readyQueue, name);
-			break;
-		case BlockedQ:
-			delete_pcb_helper(blockedQueue, name);
-			break;
-		case SusReadyQ:
-			delete_pcb_helper(suspendedReadyQueue, name);
-			break;
-		case SusBlockedQ:
-			delete_pcb_helper(suspendedBlockedQueue, name);
-			break;
-		default:
-			print("\nA PCB named \"");
-			print(name);
-			println("\" does not exist");
+		print("\nA PCB named \"");
+		print(name);
+		println("\" does not exist");
+		return;
+	}
+	if (!delete_pcb_ptr(deletedPCB))
+	{
+		print("\nThe PCB named \"");
+		print(name);
+		println("\" can't be deleted while it has I/O in progress");
 	}
 }
 
 /**
- * This function blocks the PCB with the input name. This is accomplished by moving the process to
- * the blocked queue if it is in the ready queue, or to the suspended blocked queue if it is in the
- * suspended ready queue. Additionally, the state value in the moved PCB is updated to reflect its
- * new state.
+ * This function removes a PCB from the system: it is unlinked from the queue it is in, taken
+ * off the timer wheel if it is asleep and dropped from the name index. Then it is freed, along
+ * with its stack and the heap blocks it owns (see free_pcb()), so it mustn't be the running
+ * process, whose stack is still in use. Nor may it have I/O in progress or queued for the device,
+ * since the device would go on using its buffer and then unblock it (see io_pending()); such a
+ * process is not deleted.
+ * 
+ * @param pcb - the PCB to delete
+ * @return 1 if it was deleted, 0 if it has I/O outstanding
+*/
+int delete_pcb_ptr(PCB* pcb)
+{
+	int irqs = irq_save(); // so its I/O can't be started between the check and the free
+	if (io_pending(pcb))
+	{
+		irq_restore(irqs);
+		return 0;
+	}
+
+	if ((*pcb).queue != NULL)
+		remove_pcb(pcb);
+	cancel_sleep(pcb);
+	unindex_pcb(pcb);
+	free_pcb(pcb);
+	irq_restore(irqs);
+	return 1;
+}
+
+/**
+ * This function moves a PCB from the queue it is in to another queue and gives it a new state.
+ * The PCB is unlinked through its own next/prev pointers, so this takes constant time.
+ * 
+ * @param pcb - the PCB to move
+ * @param queue - the queue to move it to
+ * @param state - the PCB's state once it has moved
+ * @param flag - 0 to insert by priority, 1 to insert FIFO (see enqueuePCB())
+*/
+static void move_pcb(PCB* pcb, Queue* queue, enum state state, int flag)
+{
+	int irqs = irq_save(); // keep the timer from seeing the PCB half moved
+	remove_pcb(pcb);
+	(*pcb).state = state;
+	enqueuePCB(queue, pcb, flag);
+	irq_restore(irqs);
+}
+
+/**
+ * This function blocks the PCB with the input name. See block_pcb_ptr().
  * 
  * @param name - the name of the process to block
 */
@@ -184,163 +278,147 @@ void block_pcb(char name[21])
 	klogv("BLOCKING:");
 	klogv(name);
 
-	PCB* movedPCB;
-	switch(findPCB(name))
+	PCB* pcb = lookup_pcb(name);
+	if (pcb == NULL)
+	{
+		klogv("Failure");
+		return;
+	}
+	block_pcb_ptr(pcb);
+}
+
+/**
+ * This function blocks a PCB. This is accomplished by moving the process to the blocked queue
+ * if it is in the ready queue, or to the suspended blocked queue if it is in the suspended ready
+ * queue. Additionally, the state value in the moved PCB is updated to reflect its new state.
+ * 
+ * @param pcb - the process to block
+ * @return 1 if the process was blocked, 0 if it was already blocked or is not in a queue
+*/
+int block_pcb_ptr(PCB* pcb)
+{
+	switch(queue_of(pcb))
 	{
 		case ReadyQ:
-			movedPCB = delete_pcb_helper(readyQueue, name);
-			(*movedPCB).next = NULL;
-			(*movedPCB).state = Blocked;
-			enqueuePCB(blockedQueue, movedPCB, 1);
-
-			//klogv("SUCCESS");
-			// print("\nSuccessfully blocked \"");
-			// print(name);
-			// println("\"");
-			break;
+			move_pcb(pcb, blockedQueue, Blocked, 1);
+			return 1;
 		case SusReadyQ:
-			movedPCB = delete_pcb_helper(suspendedReadyQueue, name);
-			(*movedPCB).next = NULL;
-			(*movedPCB).state = BlockedSuspended;
-			enqueuePCB(suspendedBlockedQueue, movedPCB, 1);
-			// print("\nSuccessfully blocked \"");
-			// print(name);
-			// println("\"");
-			break;
-		case BlockedQ:
-		case SusBlockedQ:
-			// print("\nThe process \"");
-			// print(name);
-			// println("\" is already blocked");
-			break;
+			move_pcb(pcb, suspendedBlockedQueue, BlockedSuspended, 1);
+			return 1;
 		default:
-			klogv("Failure");
-			// print("\nA PCB named \"");
-			// print(name);
-			// println("\" does not exist");
+			return 0;
 	}
 }
 
 /**
- * This function unblocks the PCB with the input name. This is accomplished by moving the process to
- * the ready queue if it is in the blocked queue, or to the suspended ready queue if it is in the
- * suspended blocked queue. Additionally, the state value in the moved PCB is updated to reflect its
- * new state.
+ * This function unblocks the PCB with the input name. See unblock_pcb_ptr().
  * 
  * @param name - the name of the process to unblock
 */
 void unblock_pcb(char name[21])
 {
-	//klogv("YAY UNBLOK");
-	//klogv(name);
-
-	// if(findPCB(name) == ReadyQ)
-	// 	klogv("BlockedQ");
+	PCB* pcb = lookup_pcb(name);
+	if (pcb != NULL)
+		unblock_pcb_ptr(pcb);
+}
 
-	PCB* movedPCB;
-	switch(findPCB(name))
+/**
+ * This function unblocks a PCB. This is accomplished by moving the process to the ready queue
+ * if it is in the blocked queue, or to the suspended ready queue if it is in the suspended
+ * blocked queue. Additionally, the state value in the moved PCB is updated to reflect its new
+ * state.
+ * 
+ * @param pcb - the process to unblock
+ * @return 1 if the process was unblocked, 0 if it was not blocked
+*/
+int unblock_pcb_ptr(PCB* pcb)
+{
+	switch(queue_of(pcb))
 	{
-		case ReadyQ:
-		case SusReadyQ:
-			// print("\nThe process \"");
-			// print(name);
-			// println("\" is not blocked");
-			break;
 		case BlockedQ:
-			movedPCB = delete_pcb_helper(blockedQueue, name);
-			(*movedPCB).next = NULL;
-			(*movedPCB).state = Ready;
-			enqueuePCB(readyQueue, movedPCB, 0);
-
-			//klogv("YEEEESSSSS");
-			// print("\nSuccessfully unblocked \"");
-			// print(name);
-			// println("\"");
-			break;
+			move_pcb(pcb, readyQueue, Ready, 0);
+			return 1;
 		case SusBlockedQ:
-			movedPCB = delete_pcb_helper(suspendedBlockedQueue, name);
-			(*movedPCB).next = NULL;
-			(*movedPCB).state = ReadySuspended;
-			enqueuePCB(suspendedReadyQueue, movedPCB, 0);
-			// print("\nSuccessfully unblocked \"");
-			// print(name);
-			// println("\"");
-			break;
+			move_pcb(pcb, suspendedReadyQueue, ReadySuspended, 0);
+			return 1;
 		default:
-			// print("\nA PCB named \"");
-			// print(name);
-			// println("\" does not exist");
-			break;
+			return 0;
 	}
 }
 
 /**
- * This function suspends the PCB with the input name. This is accomplished by moving the process to
- * the suspended ready queue if it is in the ready queue, or to the suspended blocked queue if it is in the
- * blocked queue. Additionally, the state value in the moved PCB is updated to reflect its
- * new state.
+ * This function suspends the PCB with the input name. See suspend_pcb_ptr().
  * 
  * @param name - the name of the process to suspend
  * @return 1 if suspended successfully, 0 otherwise
 */
 int suspend_pcb(char name[21])
 {
-	PCB* movedPCB;
-	switch(findPCB(name))
+	PCB* pcb = lookup_pcb(name);
+	if (pcb == NULL)
+		return 0;
+	return suspend_pcb_ptr(pcb);
+}
+
+/**
+ * This function suspends a PCB. This is accomplished by moving the process to the suspended
+ * ready queue if it is in the ready queue, or to the suspended blocked queue if it is in the
+ * blocked queue. Additionally, the state value in the moved PCB is updated to reflect its new
+ * state.
+ * 
+ * @param pcb - the process to suspend
+ * @return 1 if suspended successfully, 0 otherwise
+*/
+int suspend_pcb_ptr(PCB* pcb)
+{
+	switch(queue_of(pcb))
 	{
 		case ReadyQ:
-			movedPCB = delete_pcb_helper(readyQueue, name);
-			(*movedPCB).next = NULL;
-			(*movedPCB).state = ReadySuspended;
-			enqueuePCB(suspendedReadyQueue, movedPCB, 0);
+			move_pcb(pcb, suspendedReadyQueue, ReadySuspended, 0);
 			return 1;
-		case SusReadyQ:
-			return 0;
 		case BlockedQ:
-			movedPCB = delete_pcb_helper(blockedQueue, name);
-			(*movedPCB).next = NULL;
-			(*movedPCB).state = BlockedSuspended;
-			enqueuePCB(suspendedBlockedQueue, movedPCB, 1);
+			move_pcb(pcb, suspendedBlockedQueue, BlockedSuspended, 1);
 			return 1;
-		case SusBlockedQ:
-			return 0;
 		default:
-		return 0;
+			return 0;
 	}
 }
 
 /**
- * This function resumes the PCB with the input name. This is accomplished by moving the process to
- * the ready queue if it is in the suspended ready queue, or to the blocked queue if it is in the
- * suspended blocked queue. Additionally, the state value in the moved PCB is updated to reflect its
- * new state.
+ * This function resumes the PCB with the input name. See resume_pcb_ptr().
  * 
  * @param name - the name of the process to resume
  * @return 1 if resumed successfully, 0 otherwise
 */
 int resume_pcb(char name[21])
 {
-	PCB* movedPCB;
-	switch(findPCB(name))
+	PCB* pcb = lookup_pcb(name);
+	if (pcb == NULL)
+		return 0;
+	return resume_pcb_ptr(pcb);
+}
+
+/**
+ * This function resumes a PCB. This is accomplished by moving the process to the ready queue
+ * if it is in the suspended ready queue, or to the blocked queue if it is in the suspended
+ * blocked queue. Additionally, the state value in the moved PCB is updated to reflect its new
+ * state.
+ * 
+ * @param pcb - the process to resume
+ * @return 1 if resumed successfully, 0 otherwise
+*/
+int resume_pcb_ptr(PCB* pcb)
+{
+	switch(queue_of(pcb))
 	{
-		case ReadyQ:
-			return 0;
 		case SusReadyQ:
-			movedPCB = delete_pcb_helper(suspendedReadyQueue, name);
-			(*movedPCB).next = NULL;
-			(*movedPCB).state = Ready;
-			enqueuePCB(readyQueue, movedPCB, 0);
+			move_pcb(pcb, readyQueue, Ready, 0);
 			return 1;
-		case BlockedQ:
-			return 0;
 		case SusBlockedQ:
-			movedPCB = delete_pcb_helper(suspendedBlockedQueue, name);
-			(*movedPCB).next = NULL;
-			(*movedPCB).state = Blocked;
-			enqueuePCB(blockedQueue, movedPCB, 1);
+			move_pcb(pcb, blockedQueue, Blocked, 1);
 			return 1;
 		default:
-		return 0;
+			return 0;
 	}
 }
 
@@ -351,51 +429,39 @@ int resume_pcb(char name[21])
 */
 void resumeall_pcb()
 {
-
-	struct PCB* currPCB = (*suspendedReadyQueue).head;
-	while (currPCB != NULL) {
-		resume_pcb((*currPCB).name);
-		currPCB = (*suspendedReadyQueue).head;
-	}
-	currPCB = (*suspendedBlockedQueue).head;
-	while (currPCB != NULL) {
-		resume_pcb((*currPCB).name);
-		currPCB = (*suspendedBlockedQueue).head;
-	}
+	while ((*suspendedReadyQueue).head != NULL)
+		resume_pcb_ptr((*suspendedReadyQueue).head);
+	while ((*suspendedBlockedQueue).head != NULL)
+		resume_pcb_ptr((*suspendedBlockedQueue).head);
 }
 
 
 /**
  * This function displays the fields of a single PCB to the screen. This is accomplished by obtaining
- * the PCB with the given name using the getPCB() function in the Queue.c file and printing out each
- * of its fields using the internal_show_pcb() function.
+ * the PCB with the given name from the name index (PCBTable.c) and printing out each of its fields
+ * using the internal_show_pcb() function.
  * 
  * @param name - the name of the PCB to show
 */
 void show_pcb(char name[21])
 {
-	PCB* showPCB;
-	switch(findPCB(name))
+	PCB copy;
+	u32int used;
+
+	int irqs = irq_save(); // it can't exit between being found and being copied
+	PCB* showPCB = lookup_pcb(name);
+	if (showPCB != NULL)
+		snapshot_pcb(showPCB, &copy, &used);
+	irq_restore(irqs);
+
+	if (showPCB == NULL)
 	{
-		case ReadyQ:
-			showPCB = getPCB(readyQueue, name);
-			break;
-		case SusReadyQ:
-			showPCB = getPCB(suspendedReadyQueue, name);
-			break;
-		case BlockedQ:
-			showPCB = getPCB(blockedQueue, name);
-			break;
-		case SusBlockedQ:
-			showPCB = getPCB(suspendedBlockedQueue, name);
-			break;
-		default:
-			print("\nA PCB named \"");
-			print(name);
-			println("\" does not exist");
-			return;
+		print("\nA PCB named \"");
+		print(name);
+		println("\" does not exist");
+		return;
 	}
-	internal_show_pcb(showPCB);
+	print_pcb(&copy, used);
 }
 
 /**
@@ -407,59 +473,100 @@ void show_pcb(char name[21])
 */
 void priority_pcb(char name[21], int priority)
 {
-	PCB* priorityPCB;
-	switch(findPCB(name))
+	PCB* priorityPCB = lookup_pcb(name);
+	if (priorityPCB == NULL || (*priorityPCB).queue == NULL)
+	{
+		print("\nA PCB named \"");
+		print(name);
+		println("\" does not exist");
+		return;
+	}
+
+	int irqs = irq_save();
+	switch(queue_of(priorityPCB))
 	{
 		case ReadyQ:
-			priorityPCB = delete_pcb_helper(readyQueue, name);
-			(*priorityPCB).next = NULL;
-			(*priorityPCB).prev = NULL;
-			(*priorityPCB).priority = priority;
-			enqueuePCB(readyQueue, priorityPCB, 0);
-			break;
 		case SusReadyQ:
-			priorityPCB = delete_pcb_helper(suspendedReadyQueue, name);
-			(*priorityPCB).next = NULL;
-			(*priorityPCB).prev = NULL;
-			(*priorityPCB).priority = priority;
-			enqueuePCB(suspendedReadyQueue, priorityPCB, 0);
+			// priority queues are indexed by priority, so move it to the new level
+			requeue_pcb(priorityPCB, priority);
+			(*priorityPCB).base_priority = priority;
 			break;
-		case BlockedQ:
-			priorityPCB = getPCB(blockedQueue, name);
-			(*priorityPCB).priority = priority;
-			break;
-		case SusBlockedQ:
-			priorityPCB = getPCB(suspendedBlockedQueue, name);
+		default:
 			(*priorityPCB).priority = priority;
+			(*priorityPCB).base_priority = priority;
 			break;
-		default:
-			print("\nA PCB named \"");
-			print(name);
-			println("\" does not exist");
-			return;
 	}
+	irq_restore(irqs);
+
 	print("\nUpdated priority of \"");
 	print(name);
 	println("\"");
 }
 
+/**
+ * This function ages the processes waiting in the ready queue, so that a steady supply of higher
+ * priority work can't starve them. A process waiting in the ready queue is raised one priority
+ * level for every rate ticks it has waited, up to the highest level, and drops back to its base
+ * priority when it is dispatched. A waiting process therefore reaches the top level, where it
+ * takes turns with everything else, after at most rate * 9 ticks.
+ * 
+ * @param now - the current timer tick
+ * @param rate - the number of ticks of waiting that earns one level
+*/
+void age_ready_pcbs(u32int now, int rate)
+{
+	int irqs = irq_save();
+	PCB* pcb = (*readyQueue).head;
+	while (pcb != NULL) {
+		PCB* next = (*pcb).next; // aged PCBs move toward the head, behind the walk
+
+		u32int waited = now - (*pcb).enqueued_at;
+		u32int levels = waited / rate;
+		int target = PRIORITY_LEVELS - 1;
+		if (levels < (u32int)(PRIORITY_LEVELS - 1 - (*pcb).base_priority))
+			target = (*pcb).base_priority + levels;
+
+		if (target > (*pcb).priority)
+			requeue_pcb(pcb, target); // still waiting, so it keeps counting from when it started
+		pcb = next;
+	}
+	irq_restore(irqs);
+}
+
 /**
  * This function is used by various other functions in the PCB.c file to find which of the queues the PCB
  * with the input name is located in. Returns an enumerated type representing the queue that the PCB was
- * found in.
+ * found in. The PCB is found through the name index and knows which queue it is in, so no queue is
+ * searched.
  * 
  * @param name - the name of the process to search for in the queues
  * @return an enumerated type representing the queue the PCB was found in (ReadyQ, BlockedQ, SusReadyQ, SusBlockedQ, NoneQ)
 */
 enum queue_select findPCB(char name[21])
 {
-	if(findPCBHelper(readyQueue, name))
+	PCB* pcb = lookup_pcb(name);
+	if(pcb == NULL)
+		return NoneQ;
+	return queue_of(pcb);
+}
+
+/**
+ * This function determines which of the four queues a PCB is in, from the queue pointer the PCB
+ * keeps.
+ * 
+ * @param pcb - the PCB to check
+ * @return an enumerated type representing the queue the PCB is in (ReadyQ, BlockedQ, SusReadyQ, SusBlockedQ, NoneQ)
+*/
+enum queue_select queue_of(PCB* pcb)
+{
+	struct Queue* queue = (*pcb).queue;
+	if(queue == readyQueue)
 		return ReadyQ;
-	else if(findPCBHelper(blockedQueue, name))
+	else if(queue == blockedQueue)
 		return BlockedQ;
-	else if(findPCBHelper(suspendedReadyQueue, name))
+	else if(queue == suspendedReadyQueue)
 		return SusReadyQ;
-	else if(findPCBHelper(suspendedBlockedQueue, name))
+	else if(queue == suspendedBlockedQueue)
 		return SusBlockedQ;
 	return NoneQ;
 }
@@ -472,39 +579,97 @@ enum queue_select findPCB(char name[21])
  * @param name - the name of the PCB to allocate
  * @param type - an enum type to discern whether this is a User or System process
  * @param priority - the priority of this PCB from 0-9
+ * @param stack_size - the size of the stack in bytes (rounded up to whole pages)
  * 
  * @return a pointer to the initialized PCB or NULL if not successful
 */
-PCB* setup_pcb(char* name, enum proc_types type, int priority) {
+PCB* setup_pcb(char* name, enum proc_types type, int priority, u32int stack_size) {
+	if (stack_size == 0 || stack_size > PAGE_REGION_SIZE)
+		return NULL; // no room for a stack that size, and rounding it up would wrap
+	stack_size = (stack_size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1); // all of what is mapped is usable
+
 	PCB* newPCB = allocate_pcb();
 	if (newPCB == NULL)
 		return NULL;
 
+	// the stack lives in its own pages, with an unmapped guard page below it
+	(*newPCB).stack_base = (unsigned char*)stack_alloc(stack_size);
+	if ((*newPCB).stack_base == NULL) {
+		cache_free(&pcb_cache, newPCB);
+		return NULL;
+	}
+	(*newPCB).stack_size = stack_size;
+	memset((*newPCB).stack_base, STACK_FILL, stack_size); // overwritten as the stack is used
+
 	strcpy((*newPCB).name, name); // provided in the call to this method
 	(*newPCB).priority = priority; // provided in the call to this method
+	(*newPCB).base_priority = priority; // aging raises priority, but never this
 	(*newPCB).type = type; // provided in the call to this method
 	(*newPCB).state = Ready; // default is ready state
 	(*newPCB).next = NULL; // this should be initialized by create_pcb
 	(*newPCB).prev = NULL; // this should be initialized by create_pcb
-
-	int i; // set every value in the stack to the null character
-	for (i = 0; i < 1024; i++)
-		(*newPCB).stack_base[i] = '\0';
-
-	(*newPCB).stack_top = (*newPCB).stack_base + 1024 - sizeof(struct Context); // Added in R3
+	(*newPCB).queue = NULL; // set when the PCB is enqueued
+	(*newPCB).hash_next = NULL; // set by index_pcb
+	(*newPCB).enqueued_at = 0; // set when the PCB is enqueued
+	(*newPCB).enqueued_tsc = 0;
+	(*newPCB).sleep_next = NULL; // set by sleep_pcb
+	(*newPCB).wake_tick = 0;
+	(*newPCB).run_cycles = 0; // CPU accounting, updated on every context switch
+	(*newPCB).dispatched_at = 0;
+	(*newPCB).top_cycles = 0;
+	(*newPCB).dispatches = 0;
+	(*newPCB).voluntary_switches = 0;
+	(*newPCB).involuntary_switches = 0;
+	(*newPCB).allocations = NULL; // added to by allocate_mem while it runs
+
+	(*newPCB).stack_top = (*newPCB).stack_base + stack_size - sizeof(struct Context); // Added in R3
 
 	return newPCB;
 }
 
+/**
+ * This function copies a PCB and measures its stack, for printing after interrupts are back on
+ * (see print_pcb()), since the process could exit and be freed while its fields are printed. The
+ * copy's run_cycles includes the current time slice if it is running. Interrupts must be off.
+ * 
+ * @param pcb - the PCB to copy
+ * @param copy - where to copy it
+ * @param used - where to put how deep it has used its stack (see stack_used())
+*/
+static void snapshot_pcb(PCB* pcb, PCB* copy, u32int* used) {
+	*copy = *pcb;
+	*used = stack_used(pcb);
+	if (pcb == get_running_pcb())
+		(*copy).run_cycles += rdtsc() - (*pcb).dispatched_at;
+}
+
 /**
  * This method is effectively a toString method for a PCB. Given a reference to a PCB, 
  * 	this method will output the value of each member. Note that this is NOT the show_pcb
  * 	that we are required to implement in the project specs. All the other show_pcb methods 
  * 	can use this as a helper method once they find references to PCBs that need shown.
+ * 	The PCB is copied first (see snapshot_pcb()), so it must still exist when this is called.
  * 
  * @param pcb - the PCB to be printed
 */
 void internal_show_pcb(PCB* pcb) {
+	PCB copy;
+	u32int used;
+
+	int irqs = irq_save();
+	snapshot_pcb(pcb, &copy, &used);
+	irq_restore(irqs);
+
+	print_pcb(&copy, used);
+}
+
+/**
+ * This function prints the fields of a copy of a PCB (see snapshot_pcb()).
+ * 
+ * @param pcb - the copy to print
+ * @param used - how deep the process has used its stack
+*/
+static void print_pcb(PCB* pcb, u32int used) {
 	println("");
 	print("Name: ");
 	println((*pcb).name);
@@ -529,5 +694,128 @@ void internal_show_pcb(PCB* pcb) {
 	print("Priority: ");
 	char str[12];
 	bad_itoa(str, (*pcb).priority);
-	println(str);
-}
\ No newline at end of file
+	print(str);
+	if ((*pcb).priority != (*pcb).base_priority) {
+		print(" (aged from ");
+		bad_itoa(str, (*pcb).base_priority);
+		print(str);
+		print(")");
+	}
+	println("");
+
+	print("Stack used: ");
+	print_int(used);
+	print(" of ");
+	print_int((*pcb).stack_size);
+	println(" bytes");
+
+	print("CPU time (ms): ");
+	print_int(cycles_to_ms((*pcb).run_cycles));
+	println("");
+
+	print("Dispatches: ");
+	print_int((*pcb).dispatches);
+	println("");
+
+	print("Voluntary switches: ");
+	print_int((*pcb).voluntary_switches);
+	println("");
+
+	print("Involuntary switches: ");
+	print_int((*pcb).involuntary_switches);
+	println("");
+}
+/**
+ * This function finds how deep a process has ever used its stack. The stack was filled with
+ * STACK_FILL when it was created and grows down, so the lowest byte that no longer holds the
+ * pattern marks the deepest point reached. A value that happens to equal the pattern can make
+ * this read a little short, never long.
+ * 
+ * @param pcb - the process whose stack to measure
+ * @return the number of bytes between the top of the stack and its deepest point
+*/
+u32int stack_used(PCB* pcb) {
+	u32int fill = STACK_FILL * 0x01010101u; // the pattern repeated across a word
+	unsigned char* end = (*pcb).stack_base + (*pcb).stack_size;
+	unsigned char* addr = (*pcb).stack_base;
+
+	while (addr + sizeof(u32int) <= end && *(u32int*)addr == fill) // a word at a time,
+		addr += sizeof(u32int);
+	while (addr < end && *addr == STACK_FILL) // then to the byte
+		addr++;
+
+	return end - addr;
+}
+
+/**
+ * The stack use of one PCB, copied with interrupts off so it can be printed after.
+*/
+typedef struct StackEntry {
+	char name[21];
+	u32int size;
+	u32int used;
+} StackEntry;
+
+/**
+ * This function prints how much of its stack every process has used at its deepest, followed by
+ * a summary of the processes that have exited: the average and the deepest use of any of them.
+*/
+void show_stacks() {
+	int size = indexed_pcb_count() + 1; // main may be loading a process as we look
+	StackEntry* table = (StackEntry*)sys_alloc_mem(size * sizeof(StackEntry));
+	if (table == NULL) {
+		println("\nNot enough memory to list the stacks");
+		return;
+	}
+
+	int irqs = irq_save();
+	int count = 0;
+	PCB* pcb = next_indexed_pcb(NULL);
+	while (pcb != NULL && count < size) {
+		strcpy(table[count].name, (*pcb).name);
+		table[count].size = (*pcb).stack_size;
+		table[count].used = stack_used(pcb);
+		count++;
+		pcb = next_indexed_pcb(pcb);
+	}
+	u32int measured = stacks_measured;
+	u32int average = (measured == 0) ? 0 : stack_bytes_used / measured;
+	u32int used = deepest_used;
+	u32int used_of = deepest_size;
+	char name[21];
+	strcpy(name, deepest_name);
+	irq_restore(irqs);
+
+	println("");
+	print_column("NAME", 21);
+	print_column("SIZE", 8);
+	print_column("USED", 8);
+	println("USE%");
+
+	int i;
+	for (i = 0; i < count; i++) {
+		print_column(table[i].name, 21);
+		print_int_column(table[i].size, 8);
+		print_int_column(table[i].used, 8);
+		print_int_column(table[i].used * 100 / table[i].size, 0);
+		println("");
+	}
+	sys_free_mem(table);
+
+	print("\nExited processes measured: ");
+	print_int(measured);
+	println("");
+	if (measured == 0)
+		return;
+
+	print("Average stack used: ");
+	print_int(average);
+	println(" bytes");
+
+	print("Deepest stack used: ");
+	print_int(used);
+	print(" of ");
+	print_int(used_of);
+	print(" bytes, by ");
+	println(name);
+}
@@ -9,6 +9,9 @@
 #include "Queue.h"
 //#include "../R3/Context.c"
 
+#define DEFAULT_STACK_SIZE 4096 ///< stack size in bytes for processes with no special needs (one page)
+#define STACK_FILL 0xA5 ///< byte new stacks are filled with, so the deepest use can be found later
+
 enum proc_types{System, User};
 enum state{Ready, Running, Blocked, BlockedSuspended, ReadySuspended};
 enum queue_select {ReadyQ, BlockedQ, SusReadyQ, SusBlockedQ, NoneQ};
@@ -19,13 +22,28 @@ void allocate_queues();
 */
 typedef struct PCB {
 	char name[21]; /// name of process, must be unique, 20 character limit
-	int priority;  /// priority of process, must be 0-9
-	unsigned char stack_base[1024]; /// reference to the bottom of a 1024 byte length stack, init every char to \0
+	int priority;  /// effective priority of process, must be 0-9; raised above base_priority while it waits
+	int base_priority; /// priority it was given, restored each time it is dispatched
+	unsigned char* stack_base; /// lowest address of the stack, which is mapped separately (see stack_alloc)
+	u32int stack_size; /// size of the stack in bytes, the size requested at creation rounded up to whole pages
 	unsigned char* stack_top; /// top of the stack, initialize in create pcb
 	enum proc_types type; /// type of the process (system or user?)
 	enum state state; /// state of the process (ready? running? blocked?)
 	struct PCB* next; /// pointer to the next PCB in a queue
 	struct PCB* prev; /// pointer to the previous PCB in a queue
+	struct Queue* queue; /// the queue this PCB is currently in, NULL while running
+	struct PCB* hash_next; /// next PCB in the same bucket of the name index (see PCBTable.c)
+	u32int enqueued_at; /// timer tick at which it entered its current queue
+	u64int enqueued_tsc; /// time stamp counter when it entered its current queue, for queue statistics
+	struct PCB* sleep_next; /// next PCB in the same slot of the timer wheel (see timer_wheel.c)
+	u32int wake_tick; /// timer tick at which a sleeping PCB is made ready
+	u64int run_cycles; /// CPU cycles spent running, up to the last time it left the CPU
+	u64int dispatched_at; /// time stamp counter when it was last dispatched
+	u64int top_cycles; /// run_cycles as of the last refresh of the top command
+	u32int dispatches; /// number of times it has been given the CPU
+	u32int voluntary_switches; /// number of times it gave up the CPU through sys_req
+	u32int involuntary_switches; /// number of times the timer preempted it
+	struct CMCB* allocations; /// heap blocks it has allocated and not freed, freed with it when it ends (see free_owned_mem())
 } PCB;
 
 /**
@@ -39,10 +57,10 @@ struct Queue* getBlockedQueue();
 
 int is_system_proc(char* name);
 
-struct PCB* setup_pcb(char* name, enum proc_types type, int priority);
+struct PCB* setup_pcb(char* name, enum proc_types type, int priority, u32int stack_size);
 int free_pcb(PCB* pcb);
 
-PCB* create_pcb(char* name, enum proc_types type, int priority);
+PCB* create_pcb(char* name, enum proc_types type, int priority, u32int stack_size);
 void delete_pcb(char* name);
 void block_pcb(char* name);
 void unblock_pcb(char* name);
@@ -54,9 +72,23 @@ void show_pcb(char* name);
 void show_all();
 void show_ready();
 void show_blocked();
+void show_ready_stats();
+void show_blocked_stats();
 enum queue_select findPCB(char name[21]);
+enum queue_select queue_of(PCB* pcb);
+
+int delete_pcb_ptr(PCB* pcb);
+int block_pcb_ptr(PCB* pcb);
+int unblock_pcb_ptr(PCB* pcb);
+int suspend_pcb_ptr(PCB* pcb);
+int resume_pcb_ptr(PCB* pcb);
 
 void internal_show_pcb(PCB*);
 
+void age_ready_pcbs(u32int now, int rate);
+
+u32int stack_used(PCB* pcb);
+void show_stacks();
+
 
 #endif
@@ -0,0 +1,106 @@
+#include "PCBTable.h"
+#include "../R1/r1functions.h"
+
+/**
+ * The PCB name index. Every PCB in the system, whatever state it is in, is chained into the
+ * bucket its name hashes to through its hash_next pointer. Together with the queue pointer
+ * each PCB keeps, this answers "where is the process with this name" without searching
+ * any of the queues.
+*/
+static PCB* buckets[PCB_TABLE_SIZE];
+static int indexed = 0; /// number of PCBs in the index
+
+/**
+ * This function hashes a process name (djb2) into a bucket index.
+ * 
+ * @param name - the name to hash
+ * @return the index of the bucket for the name
+*/
+static u32int hash_name(char* name) {
+	u32int hash = 5381;
+	while (*name != '\0') {
+		hash = hash * 33 + (unsigned char)(*name);
+		name++;
+	}
+	return hash % PCB_TABLE_SIZE;
+}
+
+/**
+ * This function adds a PCB to the name index. It must be called once when a PCB is created,
+ * and the PCB's name must not already be in use.
+ * 
+ * @param pcb - the PCB to add
+*/
+void index_pcb(PCB* pcb) {
+	int irqs = irq_save();
+	u32int bucket = hash_name((*pcb).name);
+	(*pcb).hash_next = buckets[bucket];
+	buckets[bucket] = pcb;
+	indexed++;
+	irq_restore(irqs);
+}
+
+/**
+ * This function removes a PCB from the name index once it leaves the system.
+ * 
+ * @param pcb - the PCB to remove
+*/
+void unindex_pcb(PCB* pcb) {
+	int irqs = irq_save();
+	PCB** link = &buckets[hash_name((*pcb).name)];
+	while (*link != NULL) {
+		if (*link == pcb) {
+			*link = (*pcb).hash_next;
+			indexed--;
+			break;
+		}
+		link = &(**link).hash_next;
+	}
+	(*pcb).hash_next = NULL;
+	irq_restore(irqs);
+}
+
+/**
+ * This function finds the PCB with the given name, whichever queue it is in (or the running
+ * process, which is in no queue).
+ * 
+ * @param name - the name of the PCB to find
+ * @return the PCB with the given name, or NULL if there isn't one
+*/
+PCB* lookup_pcb(char* name) {
+	PCB* pcb = buckets[hash_name(name)];
+	while (pcb != NULL && !are_equal((*pcb).name, name))
+		pcb = (*pcb).hash_next;
+	return pcb;
+}
+
+/**
+ * This function returns the number of PCBs in the system.
+ * 
+ * @return the number of indexed PCBs
+*/
+int indexed_pcb_count() {
+	return indexed;
+}
+
+/**
+ * This function walks every PCB in the system, in no particular order. Start with NULL and
+ * pass each result back in until NULL is returned. The index must not change during the walk,
+ * so callers should keep interrupts off throughout.
+ * 
+ * @param pcb - the PCB returned by the previous call, or NULL to start the walk
+ * @return the next PCB, or NULL once every PCB has been visited
+*/
+PCB* next_indexed_pcb(PCB* pcb) {
+	u32int bucket = 0;
+	if (pcb != NULL) {
+		if ((*pcb).hash_next != NULL)
+			return (*pcb).hash_next;
+		bucket = hash_name((*pcb).name) + 1;
+	}
+
+	for (; bucket < PCB_TABLE_SIZE; bucket++)
+		if (buckets[bucket] != NULL)
+			return buckets[bucket];
+	return NULL;
+}
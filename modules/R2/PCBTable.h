@@ -0,0 +1,14 @@
+#ifndef PCBTableCompile
+#define PCBTableCompile
+
+#include "PCB.h"
+
+#define PCB_TABLE_SIZE 64 ///< number of buckets in the PCB name index
+
+void index_pcb(PCB* pcb);
+void unindex_pcb(PCB* pcb);
+PCB* lookup_pcb(char* name);
+int indexed_pcb_count();
+PCB* next_indexed_pcb(PCB* pcb);
+
+#endif
@@ -4,6 +4,15 @@
 #include <string.h>
 #include "PCB.h"
 #include <core/serial.h>
+#include "PCBTable.h"
+#include <core/timer.h>
+#include <core/tsc.h>
+#include "../R5/slab.h"
+
+static struct PCB* remove_by_name(struct Queue* queue, char name[21]);
+static void construct_queue(void* queue);
+
+static Cache queue_cache = CACHE_INIT("queue", Queue, construct_queue); /// where queues are allocated from
 
 /**
  * This function prints out a queue, including its size, and all members of the queue in order
@@ -35,74 +44,329 @@ void printQueue(struct Queue* queue) {
 	}
 }
 
+/**
+ * This function prints the statistics of a queue: its length now and at its longest, how many
+ * PCBs have entered and left it, and how long those that left spent in it, as a histogram with
+ * one row for each power of two of cycles that any of them fell in.
+ * 
+ * @param queue - the queue whose statistics to print
+*/
+void print_queue_stats(struct Queue* queue) {
+	int irqs = irq_save(); // take a consistent copy, since printing blocks
+	Queue stats = *queue;
+	irq_restore(irqs);
+
+	print("Length: ");
+	print_int(stats.count);
+	print(" now, ");
+	print_int(stats.peak);
+	println(" at most");
+
+	print("Enqueued: ");
+	print_int(stats.enqueues);
+	print(", left: ");
+	print_int(stats.dequeues);
+	println("");
+
+	if (stats.dequeues == 0)
+		return;
+
+	print("Time in queue (us): average ");
+	print_int(cycles_to_us(div64(stats.wait_cycles, stats.dequeues)));
+	print(", longest ");
+	print_int(cycles_to_us(stats.longest_wait));
+	println("");
+
+	print_column("TIME (us)", 24);
+	println("COUNT");
+	int bucket;
+	for (bucket = 0; bucket < WAIT_BUCKETS; bucket++) {
+		if (stats.wait_histogram[bucket] == 0)
+			continue;
+
+		char range[24];
+		char digits[12];
+		bad_itoa(digits, cycles_to_us((u64int)1 << bucket));
+		strcpy(range, digits);
+		if (bucket < WAIT_BUCKETS - 1) {
+			strcat(range, " - ");
+			bad_itoa(digits, cycles_to_us((u64int)1 << (bucket + 1)));
+			strcat(range, digits);
+		}
+		else
+			strcat(range, " or more");
+
+		print_column(range, 24);
+		print_int_column(stats.wait_histogram[bucket], 0);
+		println("");
+	}
+}
 
 /**
- * This function is used to add a PCB to a queue. It has the ability to add a value to a queue
- * either in FIFO order to based on priority, depending on the value of the flag parameter.
+ * Maps a priority level to its bit in a queue's level_bitmap. Higher priorities get lower bits
+ * so that find-first-set returns the highest non-empty level.
+*/
+#define LEVEL_BIT(level) (1u << (PRIORITY_LEVELS - 1 - (level)))
+
+/**
+ * Returns the priority level of the lowest set bit in a non-zero level bitmap
+*/
+static int first_level(u32int bitmap) {
+	return PRIORITY_LEVELS - __builtin_ffs(bitmap);
+}
+
+/**
+ * Links a PCB into a queue between two adjacent PCBs, either of which may be NULL at the
+ * ends of the queue.
+ * 
+ * @param queue - the queue to link into
+ * @param prev - the PCB that will come before the new PCB (NULL for the head)
+ * @param next - the PCB that will come after the new PCB (NULL for the tail)
+ * @param pcb - the PCB to link in
+*/
+static void link_between(struct Queue* queue, struct PCB* prev, struct PCB* next, struct PCB* pcb) {
+	(*pcb).prev = prev;
+	(*pcb).next = next;
+	(*pcb).queue = queue;
+
+	if (prev != NULL)
+		(*prev).next = pcb;
+	else
+		(*queue).head = pcb;
+
+	if (next != NULL)
+		(*next).prev = pcb;
+	else
+		(*queue).tail = pcb;
+}
+
+/**
+ * Unlinks a PCB from the queue it is in, in constant time, keeping the priority level
+ * bookkeeping up to date. Callers must have interrupts disabled.
+ * 
+ * @param queue - the queue the PCB is currently in
+ * @param pcb - the PCB to remove
+*/
+static void unlink_pcb(struct Queue* queue, struct PCB* pcb) {
+	int level = (*pcb).priority;
+
+	if ((*queue).level_head[level] == pcb && (*queue).level_tail[level] == pcb) {
+		(*queue).level_head[level] = NULL;
+		(*queue).level_tail[level] = NULL;
+		(*queue).level_bitmap &= ~LEVEL_BIT(level);
+	}
+	else if ((*queue).level_head[level] == pcb)
+		(*queue).level_head[level] = (*pcb).next;
+	else if ((*queue).level_tail[level] == pcb)
+		(*queue).level_tail[level] = (*pcb).prev;
+
+	if ((*pcb).prev != NULL)
+		(*(*pcb).prev).next = (*pcb).next;
+	else
+		(*queue).head = (*pcb).next;
+
+	if ((*pcb).next != NULL)
+		(*(*pcb).next).prev = (*pcb).prev;
+	else
+		(*queue).tail = (*pcb).prev;
+
+	(*pcb).next = NULL;
+	(*pcb).prev = NULL;
+	(*pcb).queue = NULL;
+	(*queue).count = (*queue).count - 1;
+}
+
+/**
+ * Links a PCB into a queue, either in FIFO order or based on priority. Priority insertion appends
+ * the PCB to the run of its own priority level, or starts a new run in front of the next lower
+ * non-empty level, so it takes constant time regardless of the length of the queue. Callers
+ * must have interrupts disabled.
  * 
  * @param queue - the queue to add the PCB to
  * @param PCB - the PCB to add to the queue
  * @param flag - if this is 0, insert using priority, and if it is 1, insert using FIFO
 */
-void enqueuePCB(struct Queue* queue, struct PCB* pcb, int flag){
+static void insert_pcb(struct Queue* queue, struct PCB* pcb, int flag) {
 
-	struct PCB* currPCB = (*queue).head;
 	//FLAG = 0 (PRIORITY SORT)
 	if(flag == 0){
-		if((*queue).count == 0){
-			(*queue).head = pcb;
-			(*queue).tail = pcb;
-			(*pcb).next = NULL;
-			(*pcb).prev = NULL;
-		}
-		else if((*currPCB).priority < (*pcb).priority){
-			(*pcb).next = (*queue).head;
-			(*queue).head = pcb;
-			(*(*pcb).next).prev = pcb;
-			(*pcb).prev = NULL;
+		int level = (*pcb).priority;
+
+		if ((*queue).level_tail[level] != NULL) {
+			struct PCB* last = (*queue).level_tail[level];
+			link_between(queue, last, (*last).next, pcb);
 		}
-		else{
-			while((*currPCB).next != NULL && (*(*currPCB).next).priority >= (*pcb).priority){
-				currPCB = (*currPCB).next;
+		else {
+			// find the next lower priority level that has PCBs in it
+			u32int lower = (*queue).level_bitmap & ~((LEVEL_BIT(level) << 1) - 1);
+			if (lower != 0) {
+				struct PCB* next = (*queue).level_head[first_level(lower)];
+				link_between(queue, (*next).prev, next, pcb);
 			}
-			(*pcb).next = (*currPCB).next;
-			(*pcb).prev = currPCB;
-
-			(*(*currPCB).next).prev = pcb;
+			else
+				link_between(queue, (*queue).tail, NULL, pcb);
 
-			(*currPCB).next = pcb;
+			(*queue).level_head[level] = pcb;
+			(*queue).level_bitmap |= LEVEL_BIT(level);
 		}
-		
-	
+		(*queue).level_tail[level] = pcb;
 		
 	//FLAG = 1	(FIFO SORT)
 	} else {
-		if ((*queue).count == 0) {
-			(*queue).head = pcb;
-			(*queue).tail = pcb;
-			(*pcb).next = NULL;
-			(*pcb).prev = NULL;
-		} else {
-			(*(*queue).tail).next = pcb;
-			(*pcb).prev = (*queue).tail;
-			(*queue).tail = pcb;
-		}
-
+		link_between(queue, (*queue).tail, NULL, pcb);
 	}
 	(*queue).count = (*queue).count + 1;
 }
 
 /**
- * This function is used to allocate memory for a queue
+ * Returns the wait histogram bucket for a number of cycles: the position of its highest set
+ * bit, so bucket b holds waits of 2^b to 2^(b+1) cycles.
+*/
+static int wait_bucket(u64int cycles) {
+	int bucket = 0;
+	if (cycles >> 32)
+		bucket = 63 - __builtin_clz((u32int)(cycles >> 32));
+	else if (cycles != 0)
+		bucket = 31 - __builtin_clz((u32int)cycles);
+
+	return (bucket < WAIT_BUCKETS) ? bucket : WAIT_BUCKETS - 1;
+}
+
+/**
+ * Unlinks a PCB that is leaving a queue, and records how long it was there in the queue's
+ * statistics. Callers must have interrupts disabled.
+ * 
+ * @param queue - the queue the PCB is currently in
+ * @param pcb - the PCB to remove
+*/
+static void leave_queue(struct Queue* queue, struct PCB* pcb) {
+	unlink_pcb(queue, pcb);
+
+	u64int waited = rdtsc() - (*pcb).enqueued_tsc;
+	(*queue).dequeues++;
+	(*queue).wait_cycles += waited;
+	if (waited > (*queue).longest_wait)
+		(*queue).longest_wait = waited;
+	(*queue).wait_histogram[wait_bucket(waited)]++;
+}
+
+/**
+ * This function is used to add a PCB to a queue. It has the ability to add a value to a queue
+ * either in FIFO order to based on priority, depending on the value of the flag parameter,
+ * in constant time either way (see insert_pcb()). The PCB is stamped with the time it entered,
+ * for aging and for the queue's statistics.
+ * 
+ * @param queue - the queue to add the PCB to
+ * @param PCB - the PCB to add to the queue
+ * @param flag - if this is 0, insert using priority, and if it is 1, insert using FIFO
+*/
+void enqueuePCB(struct Queue* queue, struct PCB* pcb, int flag){
+
+	int irqs = irq_save(); // the timer may requeue the running process
+
+	insert_pcb(queue, pcb, flag);
+	(*pcb).enqueued_at = get_ticks();
+	(*pcb).enqueued_tsc = rdtsc();
+
+	(*queue).enqueues++;
+	if ((*queue).count > (*queue).peak)
+		(*queue).peak = (*queue).count;
+
+	irq_restore(irqs);
+}
+
+/**
+ * This function removes and returns the PCB at the front of a queue. For priority queues this
+ * is the oldest PCB in the highest non-empty priority level. Takes constant time.
+ * 
+ * @param queue - the queue to remove the PCB from
+ * @return the PCB that was removed, or NULL if the queue is empty
+*/
+struct PCB* dequeuePCB(struct Queue* queue) {
+	int irqs = irq_save();
+	struct PCB* pcb;
+
+	if ((*queue).level_bitmap != 0)
+		pcb = (*queue).level_head[first_level((*queue).level_bitmap)];
+	else
+		pcb = (*queue).head;
+
+	if (pcb != NULL)
+		leave_queue(queue, pcb);
+
+	irq_restore(irqs);
+	return pcb;
+}
+
+/**
+ * This function removes a PCB from whichever queue it is in, in constant time, using the PCB's
+ * own queue, next and prev pointers.
+ * 
+ * @param pcb - the PCB to remove (must currently be in a queue)
+*/
+void remove_pcb(struct PCB* pcb) {
+	int irqs = irq_save();
+	leave_queue((*pcb).queue, pcb);
+	irq_restore(irqs);
+}
+
+/**
+ * This function changes the priority of a PCB in a priority queue, moving it to the run of its
+ * new level. The PCB hasn't left the queue, so this isn't counted in the queue's statistics and
+ * the time it entered the queue is kept.
+ * 
+ * @param pcb - the PCB to move (must currently be in a priority queue)
+ * @param priority - its new priority
+*/
+void requeue_pcb(struct PCB* pcb, int priority) {
+	int irqs = irq_save();
+	struct Queue* queue = (*pcb).queue;
+	unlink_pcb(queue, pcb);
+	(*pcb).priority = priority;
+	insert_pcb(queue, pcb, 0);
+	irq_restore(irqs);
+}
+
+/**
+ * This function returns the highest priority of any PCB in a priority queue.
+ * 
+ * @param queue - the queue to check
+ * @return the highest priority level present, or -1 if the queue is empty
+*/
+int highest_priority(struct Queue* queue) {
+	if ((*queue).level_bitmap == 0)
+		return -1;
+	return first_level((*queue).level_bitmap);
+}
+
+/**
+ * This function removes every PCB from a queue without freeing them.
+ * 
+ * @param queue - the queue to empty
+*/
+void empty_queue(struct Queue* queue) {
+	int irqs = irq_save();
+	memset(queue, 0, sizeof(Queue));
+	irq_restore(irqs);
+}
+
+/**
+ * The constructor of the queue cache: every queue starts out empty.
+ * 
+ * @param queue - the queue to construct
+*/
+static void construct_queue(void* queue) {
+	memset(queue, 0, sizeof(Queue));
+}
+
+/**
+ * This function is used to allocate memory for a queue. Queues come from the queue cache
+ * (see slab.c) already empty.
  * 
  * @return the newly allocated queue
 */
 Queue* allocate_queue() {
-	Queue* newQueue = sys_alloc_mem(sizeof(Queue));
-	if (newQueue)
-		return newQueue;
-	else 
-		return NULL;
+	return cache_alloc(&queue_cache);
 }
 
 /**
@@ -116,32 +380,23 @@ Queue* allocate_queue() {
 */
 int findPCBHelper(struct Queue* queue, char name[21])
 {
-	struct PCB* currPCB = (*queue).head;
-	while(currPCB != NULL) {
-		if(are_equal((*currPCB).name, name))
-			return 1;
-		currPCB = (*currPCB).next;
-	}
-	return 0;
+	return getPCB(queue, name) != NULL;
 }
 
 /**
- * This function is used to get the PCB with the input name from the input queue, and works
- * effectively the same as the findPCBHelper() function.
+ * This function is used to get the PCB with the input name from the input queue. The PCB is
+ * found through the name index, so this does not search the queue.
  * 
  * @param queue - the queue to search for the PCB in
  * @param name - the name of the PCB to search for
  * 
- * @return the PCB that was found in the queue
+ * @return the PCB that was found in the queue, or NULL if it is not in that queue
 */
 struct PCB* getPCB(struct Queue* queue, char name[21])
 {
-	struct PCB* currPCB = (*queue).head;
-	while(currPCB != NULL) {
-		if(are_equal((*currPCB).name, name))
-			return currPCB;
-		currPCB = (*currPCB).next;
-	}
+	struct PCB* pcb = lookup_pcb(name);
+	if(pcb != NULL && (*pcb).queue == queue)
+		return pcb;
 	return NULL;
 }
 
@@ -156,39 +411,24 @@ struct PCB* getPCB(struct Queue* queue, char name[21])
 */
 struct PCB* delete_pcb_helper(struct Queue* queue, char name[21])
 {
-	struct PCB* currPCB = (*queue).head;
-	if(are_equal((*currPCB).name, name))
-	{
-		(*queue).head = (*currPCB).next;
-		(*queue).count = (*queue).count - 1;
-		(*(*queue).head).prev = NULL;
-		return currPCB;
-	}
-
-	if(currPCB != NULL)
-		currPCB = (*currPCB).next;
-
-	while(currPCB != NULL) 
-	{
-		if(are_equal((*currPCB).name, name))
-		{
-			struct PCB* prevPCB = (*currPCB).prev;
-			struct PCB* nextPCB = (*currPCB).next;
-
-			(*prevPCB).next = nextPCB;
-
-			if(nextPCB != NULL)
-				(*nextPCB).prev = prevPCB;
-			else
-				(*queue).tail = prevPCB;
-
-			(*queue).count = (*queue).count - 1;
-			//free_pcb(currPCB);
-			return currPCB;
-		}
-		currPCB = (*currPCB).next;
-	}
-	return NULL;
+	int irqs = irq_save(); // the timer may requeue the running process
+	struct PCB* removedPCB = remove_by_name(queue, name);
+	irq_restore(irqs);
+	return removedPCB;
 }
 
-
+/**
+ * Unlinks the PCB with the given name from the queue. Callers must have interrupts disabled.
+ * 
+ * @param queue - the queue to delete the PCB from
+ * @param name - the name of the PCB to delete
+ * 
+ * @return the PCB that was removed from the queue
+*/
+static struct PCB* remove_by_name(struct Queue* queue, char name[21])
+{
+	struct PCB* currPCB = getPCB(queue, name);
+	if (currPCB != NULL)
+		leave_queue(queue, currPCB);
+	return currPCB;
+}
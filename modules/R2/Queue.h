@@ -9,10 +9,30 @@
 #include "PCB.h"
 #include <core/serial.h>
 
+#define PRIORITY_LEVELS 10 ///< priorities run from 0 (lowest) to 9 (highest)
+#define WAIT_BUCKETS 40 ///< wait histogram buckets; bucket b counts waits of 2^b to 2^(b+1) cycles
+
+/**
+ * A queue of PCBs. FIFO queues only use head/tail. Priority queues keep one FIFO run per
+ * priority level, laid end to end from highest to lowest priority so that head is always the
+ * next process to dispatch. level_head/level_tail bound each run and bit (9 - p) of
+ * level_bitmap is set while level p is non-empty, so the highest non-empty level is a
+ * single find-first-set away.
+*/
 typedef struct Queue {
 	int count;
     struct PCB* head;
 	struct PCB* tail;
+	struct PCB* level_head[PRIORITY_LEVELS];
+	struct PCB* level_tail[PRIORITY_LEVELS];
+	u32int level_bitmap;
+
+	int peak; /// the most PCBs the queue has held at once
+	u32int enqueues; /// PCBs added by enqueuePCB()
+	u32int dequeues; /// PCBs that have left, whether dispatched, unblocked, suspended or deleted
+	u64int wait_cycles; /// total time those PCBs spent in the queue, for the average
+	u64int longest_wait; /// longest time any of them spent in the queue
+	u32int wait_histogram[WAIT_BUCKETS]; /// those times by power of two cycles (see WAIT_BUCKETS)
 } Queue;
 
 void printQueue(struct Queue* queue);
@@ -20,6 +40,18 @@ void printQueue(struct Queue* queue);
 
 void enqueuePCB(Queue* queue, struct PCB* pcb, int flag);
 
+struct PCB* dequeuePCB(Queue* queue);
+
+void remove_pcb(struct PCB* pcb);
+
+void requeue_pcb(struct PCB* pcb, int priority);
+
+void print_queue_stats(struct Queue* queue);
+
+int highest_priority(Queue* queue);
+
+void empty_queue(Queue* queue);
+
 int findPCBHelper(struct Queue* queue, char name[21]);
 
 Queue* allocate_queue();
@@ -0,0 +1,185 @@
+#include "Top.h"
+#include "PCBTable.h"
+#include "../R1/r1functions.h"
+#include "../mpx_supt.h"
+#include <string.h>
+#include <core/timer.h>
+#include <core/tsc.h>
+
+/**
+ * A copy of the accounting fields of one PCB, taken with interrupts off so the table can be
+ * sorted and printed (which blocks on I/O) without the PCB changing or going away underneath it.
+*/
+typedef struct TopEntry {
+	char name[21];
+	enum state state;
+	int priority;
+	u64int cycles; /// total cycles used, including the current time slice if running
+	u64int recent; /// cycles used since the previous refresh
+	u32int dispatches;
+	u32int voluntary;
+	u32int involuntary;
+} TopEntry;
+
+static u64int last_refresh = 0; /// time stamp counter at the previous refresh
+static u64int last_idle = 0; /// idle cycles at the previous refresh
+
+/**
+ * This function returns a short name for a process state.
+ * 
+ * @param state - the state to name
+ * @return the name of the state
+*/
+static char* state_name(enum state state) {
+	switch(state) {
+		case Ready:            return "ready";
+		case Running:          return "running";
+		case Blocked:          return "blocked";
+		case BlockedSuspended: return "blocked/s";
+		case ReadySuspended:   return "ready/s";
+		default:               return "unknown";
+	}
+}
+
+/**
+ * This function prints part/whole as a percentage with one decimal place. Both values are
+ * scaled down until the multiplication fits in 32 bits, which avoids 64 bit division.
+ * 
+ * @param part - the cycles used by one process
+ * @param whole - the cycles that elapsed
+ * @param width - the width of the column
+*/
+static void print_share_column(u64int part, u64int whole, int width) {
+	while (whole >> 22) {
+		whole >>= 1;
+		part >>= 1;
+	}
+
+	u32int permille = 0;
+	if (whole != 0)
+		permille = (u32int)part * 1000 / (u32int)whole;
+
+	char str[16];
+	char digits[12];
+	bad_itoa(digits, (int)(permille / 10));
+	strcpy(str, digits);
+	strcat(str, ".");
+	bad_itoa(digits, (int)(permille % 10));
+	strcat(str, digits);
+	strcat(str, "%");
+	print_column(str, width);
+}
+
+/**
+ * This function copies the accounting fields of every PCB into the given table and starts a new
+ * refresh interval.
+ * 
+ * @param table - the table to fill
+ * @param size - the number of entries the table can hold
+ * @param interval - set to the cycles elapsed since the previous refresh
+ * @param idle - set to the cycles spent halted since the previous refresh
+ * @return the number of entries filled
+*/
+static int snapshot(TopEntry* table, int size, u64int* interval, u64int* idle) {
+	int irqs = irq_save();
+
+	u64int now = rdtsc();
+	PCB* running = get_running_pcb();
+	int count = 0;
+	PCB* pcb = next_indexed_pcb(NULL);
+
+	while (pcb != NULL && count < size) {
+		TopEntry* entry = &table[count++];
+		strcpy((*entry).name, (*pcb).name);
+		(*entry).state = (*pcb).state;
+		(*entry).priority = (*pcb).priority;
+		(*entry).cycles = (*pcb).run_cycles;
+		if (pcb == running)
+			(*entry).cycles += now - (*pcb).dispatched_at;
+		(*entry).recent = (*entry).cycles - (*pcb).top_cycles;
+		(*entry).dispatches = (*pcb).dispatches;
+		(*entry).voluntary = (*pcb).voluntary_switches;
+		(*entry).involuntary = (*pcb).involuntary_switches;
+		(*pcb).top_cycles = (*entry).cycles;
+		pcb = next_indexed_pcb(pcb);
+	}
+
+	// the first refresh covers everything since the processes were created
+	*interval = (last_refresh == 0) ? 0 : now - last_refresh;
+	*idle = sys_get_idle_cycles() - last_idle;
+	last_refresh = now;
+	last_idle = sys_get_idle_cycles();
+
+	irq_restore(irqs);
+	return count;
+}
+
+/**
+ * This function prints every process in the system, busiest first, with the share of the CPU
+ * each has used since the previous call (or since it was created, on the first call), its total
+ * CPU time, and how often it has been dispatched and switched out.
+*/
+void show_top() {
+	int size = indexed_pcb_count() + 1; // main may be loading a process as we look
+	TopEntry* table = (TopEntry*)sys_alloc_mem(size * sizeof(TopEntry));
+	if (table == NULL) {
+		println("\nNot enough memory to list the processes");
+		return;
+	}
+
+	u64int interval, idle;
+	int count = snapshot(table, size, &interval, &idle);
+
+	if (interval == 0) {
+		// first refresh: measure against the total of what has been used
+		int i;
+		interval = idle;
+		for (i = 0; i < count; i++)
+			interval += table[i].recent;
+	}
+
+	int i, j; // insertion sort, busiest first
+	for (i = 1; i < count; i++) {
+		TopEntry entry = table[i];
+		for (j = i; j > 0 && table[j - 1].recent < entry.recent; j--)
+			table[j] = table[j - 1];
+		table[j] = entry;
+	}
+
+	println("");
+	print_column("NAME", 21);
+	print_column("STATE", 11);
+	print_column("PRI", 5);
+	print_column("CPU", 8);
+	print_column("TIME(ms)", 10);
+	print_column("DISP", 8);
+	print_column("VOL", 8);
+	println("INVOL");
+
+	for (i = 0; i < count; i++) {
+		print_column(table[i].name, 21);
+		print_column(state_name(table[i].state), 11);
+		print_int_column(table[i].priority, 5);
+		print_share_column(table[i].recent, interval, 8);
+		print_int_column(cycles_to_ms(table[i].cycles), 10);
+		print_int_column(table[i].dispatches, 8);
+		print_int_column(table[i].voluntary, 8);
+		print_int_column(table[i].involuntary, 0);
+		println("");
+	}
+
+	print_column("(halted)", 37);
+	print_share_column(idle, interval, 8);
+	print_int_column(cycles_to_ms(sys_get_idle_cycles()), 0);
+	println("");
+
+	u32int reaped, bytes;
+	sys_get_reaped(&reaped, &bytes);
+	print("Exited processes reclaimed: ");
+	print_int(reaped);
+	print(" (");
+	print_int(bytes);
+	println(" bytes)");
+
+	sys_free_mem(table);
+}
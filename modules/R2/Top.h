@@ -0,0 +1,8 @@
+#ifndef TopCompile
+#define TopCompile
+
+#include "PCB.h"
+
+void show_top();
+
+#endif
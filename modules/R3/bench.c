@@ -0,0 +1,91 @@
+#include "bench.h"
+#include "loadr3.h"
+#include "../R1/r1functions.h"
+#include "../R2/PCB.h"
+#include "../R2/PCBTable.h"
+#include "../mpx_supt.h"
+#include <core/tsc.h>
+
+#define PING "BenchPing"
+#define PONG "BenchPong"
+
+static volatile int pong_stop; /// set by ping to tell pong to exit
+static volatile int bench_done; /// set by ping once both processes are finished with
+static u64int yield_cycles; /// cycles per yield with nothing else ready
+static u64int round_trip_cycles; /// cycles per ping -> pong -> ping round trip
+
+/**
+ * The second half of the ping-pong: yields back to ping until it is told to stop.
+*/
+static void bench_pong() {
+	while (!pong_stop)
+		sys_req(IDLE, DEFAULT_DEVICE, NULL, NULL);
+	sys_req(EXIT, DEFAULT_DEVICE, NULL, NULL);
+}
+
+/**
+ * The benchmark process. It first times yields with nothing else ready (the dispatcher's fast
+ * path), then starts pong and times yields that switch to pong and back, so each one is a full
+ * round trip of two context switches.
+*/
+static void bench_ping() {
+	int i;
+	u64int start = rdtsc();
+	for (i = 0; i < BENCH_ROUNDS; i++)
+		sys_req(IDLE, DEFAULT_DEVICE, NULL, NULL);
+	yield_cycles = div64(rdtsc() - start, BENCH_ROUNDS);
+
+	pong_stop = 0;
+	PCB* pong = load_proc(PONG, System, 9, bench_pong, DEFAULT_STACK_SIZE);
+	if (pong == NULL) {
+		round_trip_cycles = 0; // reported as 0: no memory for the second process
+		bench_done = 1;
+		sys_req(EXIT, DEFAULT_DEVICE, NULL, NULL);
+	}
+	resume_pcb_ptr(pong);
+	sys_req(IDLE, DEFAULT_DEVICE, NULL, NULL); // let pong reach its loop before timing
+
+	start = rdtsc();
+	for (i = 0; i < BENCH_ROUNDS; i++)
+		sys_req(IDLE, DEFAULT_DEVICE, NULL, NULL);
+	round_trip_cycles = div64(rdtsc() - start, BENCH_ROUNDS);
+
+	pong_stop = 1;
+	while (lookup_pcb(PONG) != NULL)
+		sys_req(IDLE, DEFAULT_DEVICE, NULL, NULL);
+
+	bench_done = 1;
+	sys_req(EXIT, DEFAULT_DEVICE, NULL, NULL);
+}
+
+/**
+ * This function runs the context switch microbenchmark and prints the results. The calling
+ * process sleeps while the benchmark runs so that it doesn't take part in the ping-pong; any
+ * other ready process will, and will inflate the numbers.
+*/
+void run_bench() {
+	if (lookup_pcb(PING) != NULL || lookup_pcb(PONG) != NULL) {
+		println("\nThe benchmark is already running");
+		return;
+	}
+
+	bench_done = 0;
+	PCB* ping = load_proc(PING, System, 9, bench_ping, DEFAULT_STACK_SIZE);
+	if (ping == NULL) {
+		println("\nNot enough memory to run the benchmark");
+		return;
+	}
+	resume_pcb_ptr(ping);
+
+	int ms = 100; // long enough that waking up to check barely disturbs the timings
+	while (!bench_done)
+		sys_req(SLEEP, DEFAULT_DEVICE, NULL, &ms);
+
+	println("");
+	print("Yield, nothing else ready: ");
+	print_int((int)yield_cycles);
+	println(" cycles");
+	print("Ping-pong round trip (2 switches): ");
+	print_int((int)round_trip_cycles);
+	println(" cycles");
+}
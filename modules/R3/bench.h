@@ -0,0 +1,8 @@
+#ifndef BenchCompile
+#define BenchCompile
+
+#define BENCH_ROUNDS 10000 ///< number of yields timed in each part of the benchmark
+
+void run_bench();
+
+#endif
@@ -2,6 +2,7 @@
 #include "../R1/r1functions.h"
 #include "../R2/PCB.h"
 #include "../R2/Queue.h"
+#include "../R2/PCBTable.h"
 #include "procsr3.h"
 
 /**
@@ -10,40 +11,108 @@
 */
 void loadr3()
 {
-	load_proc("proc1", User, 1, proc1);
-	load_proc("proc2", User, 2, proc2);
-	load_proc("proc3", User, 3, proc3);
-	load_proc("proc4", User, 4, proc4);
-	load_proc("proc5", User, 5, proc5);
+	load_proc("proc1", User, 1, proc1, DEFAULT_STACK_SIZE);
+	load_proc("proc2", User, 2, proc2, DEFAULT_STACK_SIZE);
+	load_proc("proc3", User, 3, proc3, DEFAULT_STACK_SIZE);
+	load_proc("proc4", User, 4, proc4, DEFAULT_STACK_SIZE);
+	load_proc("proc5", User, 5, proc5, DEFAULT_STACK_SIZE);
 }
 
 /**
- * This function loads in a process with the given attributes so that it can be run in the system. This function was
- * made specifically for loading in processes for R3, and so the processes will be given CPU time when the "yield"
- * command is run.
- * 
- * @param name - the name to give the process that is loaded in
- * @param type - the type of process to create (either a User or a System process)
- * @param priority - the priority to give to the process that is loaded in
- * @param proc - a pointer to the function to execute as part of the created process
+ * This function is where a process goes if its function returns rather than exiting, since
+ * init_context() leaves its address as the function's return address.
+*/
+static void proc_return()
+{
+	sys_req(EXIT, DEFAULT_DEVICE, NULL, NULL);
+}
+
+/**
+ * This function builds the initial context of a new process at the top of its stack, so that
+ * the first dispatch starts it at the beginning of proc. Above the context it leaves a call
+ * frame, as if proc(arg) had been called from proc_return(), so proc can take an argument and
+ * a process that returns exits.
  * 
- * @return the PCB that was created and added to the suspended ready queue
+ * @param pcb - the newly created process, which must not have run yet
+ * @param proc - a pointer to the function to execute as part of the process
+ * @param arg - the argument to pass to proc
 */
-PCB* load_proc(char* name, enum proc_types type, int priority, void* proc)
+void init_context(PCB* pcb, void* proc, void* arg)
 {
-	PCB* testPCB = create_pcb(name, type, priority); // Note: in the slides, it allows the user to specify the size of the stack when creating PCB, should we implement this?
-	suspend_pcb(testPCB -> name);
-	Context* cp = (Context *)(testPCB -> stack_top);
+	u32int* frame = (u32int*)((pcb -> stack_base) + (pcb -> stack_size)) - 2;
+	frame[0] = (u32int) proc_return;
+	frame[1] = (u32int) arg;
+
+	Context* cp = (Context *)frame - 1;
 	memset(cp, 0, sizeof(Context));
 	cp -> fs = 0x10;
 	cp -> gs = 0x10;
 	cp -> ds = 0x10;
 	cp -> es = 0x10;
 	cp -> cs = 0x8;
-	cp -> ebp = (u32int)(testPCB -> stack_base);
-	cp -> esp = (u32int)(testPCB -> stack_top);
+	cp -> ebp = (u32int)(pcb -> stack_base);
+	cp -> esp = (u32int)cp;
 	cp -> eip = (u32int) proc;
 	cp -> eflags = 0x202;
+	pcb -> stack_top = (unsigned char*)cp;
+}
+
+/**
+ * This function creates a process that starts running proc(arg) and places it in the ready
+ * queue. The process is set up with interrupts off, so the dispatcher never sees it half built.
+ * It prints nothing and makes no system calls, even when there isn't enough memory (the heap
+ * only logs that, see klogv()), so it is safe to call from the system call handler (see SPAWN).
+ * 
+ * @param name - the name to give the process, which must not be in use
+ * @param type - the type of process to create (either a User or a System process)
+ * @param priority - the priority to give to the process
+ * @param proc - a pointer to the function to execute as part of the created process
+ * @param arg - the argument to pass to proc
+ * @param stack_size - the size of the process's stack in bytes
+ * 
+ * @return the PCB that was created, or NULL if the name is taken or there isn't enough memory
+*/
+PCB* spawn_proc(char* name, enum proc_types type, int priority, void* proc, void* arg, u32int stack_size)
+{
+	PCB* pcb = NULL;
+	int irqs = irq_save();
+	if (lookup_pcb(name) == NULL) {
+		pcb = create_pcb(name, type, priority, stack_size);
+		if (pcb != NULL)
+			init_context(pcb, proc, arg);
+	}
+	irq_restore(irqs);
+	return pcb;
+}
+
+/**
+ * This function loads in a process with the given attributes so that it can be run in the system. This function was
+ * made specifically for loading in processes for R3, and so the processes will be given CPU time when the "yield"
+ * command is run.
+ * 
+ * @param name - the name to give the process that is loaded in
+ * @param type - the type of process to create (either a User or a System process)
+ * @param priority - the priority to give to the process that is loaded in
+ * @param proc - a pointer to the function to execute as part of the created process
+ * @param stack_size - the size of the process's stack in bytes
+ * 
+ * @return the PCB that was created and added to the suspended ready queue, or NULL if it couldn't be
+*/
+PCB* load_proc(char* name, enum proc_types type, int priority, void* proc, u32int stack_size)
+{
+	if (lookup_pcb(name) != NULL)
+	{
+		print("\nA PCB named \"");
+		print(name);
+		println("\" already exists");
+		return NULL;
+	}
+
+	int irqs = irq_save(); // suspend it before it can be dispatched
+	PCB* testPCB = spawn_proc(name, type, priority, proc, NULL, stack_size);
+	if (testPCB != NULL)
+		suspend_pcb_ptr(testPCB);
+	irq_restore(irqs);
 
 	return testPCB;
 }
\ No newline at end of file
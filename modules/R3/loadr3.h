@@ -2,4 +2,6 @@
 #include "../R2/PCB.h"
 
 void loadr3();
-PCB* load_proc(char* name, enum proc_types type, int priority, void* proc);
\ No newline at end of file
+void init_context(PCB* pcb, void* proc, void* arg);
+PCB* spawn_proc(char* name, enum proc_types type, int priority, void* proc, void* arg, u32int stack_size);
+PCB* load_proc(char* name, enum proc_types type, int priority, void* proc, u32int stack_size);
\ No newline at end of file
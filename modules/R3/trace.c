@@ -0,0 +1,151 @@
+#include "trace.h"
+#include "../R1/r1functions.h"
+#include "../mpx_supt.h"
+#include <core/timer.h>
+#include <core/tsc.h>
+
+/**
+ * One record of the dispatch trace. Names are copied rather than pointing at the PCBs, so the
+ * trace still makes sense after a process has exited and its PCB has been freed.
+*/
+typedef struct TraceRecord {
+	u64int tsc; /// time stamp counter when the request was handled
+	int op_code; /// the sys_req op code, or TRACE_PREEMPT
+	int ready; /// number of processes in the ready queue on entry
+	char outgoing[21]; /// process that left the CPU ("" if none)
+	char incoming[21]; /// process that was dispatched ("" if none)
+} TraceRecord;
+
+/**
+ * The trace itself. It is allocated up front and overwritten oldest first, so recording never
+ * allocates and never fails, which is what lets sys_call use it with interrupts off.
+*/
+static TraceRecord records[TRACE_SIZE];
+static u32int recorded = 0; /// number of records written since the last clear
+static int dumping = 0; /// nonzero while trace_dump() is printing, when nothing is recorded
+
+/**
+ * This function copies a process name into a trace record.
+ * 
+ * @param dest - the name field to fill
+ * @param pcb - the process, or NULL
+*/
+static void copy_name(char* dest, PCB* pcb) {
+	if (pcb == NULL)
+		dest[0] = '\0';
+	else
+		strcpy(dest, (*pcb).name);
+}
+
+/**
+ * This function records one pass through the dispatcher. It may be called with interrupts off.
+ * 
+ * @param op_code - the request being handled, or TRACE_PREEMPT for a timer preemption
+ * @param outgoing - the process that left the CPU, or NULL
+ * @param incoming - the process that was dispatched, or NULL
+ * @param ready - the depth of the ready queue when the request was made
+*/
+void trace_switch(int op_code, PCB* outgoing, PCB* incoming, int ready) {
+	int irqs = irq_save();
+	if (dumping) {
+		irq_restore(irqs);
+		return;
+	}
+
+	TraceRecord* record = &records[recorded & (TRACE_SIZE - 1)];
+	recorded++;
+
+	(*record).tsc = rdtsc();
+	(*record).op_code = op_code;
+	(*record).ready = ready;
+	copy_name((*record).outgoing, outgoing);
+	copy_name((*record).incoming, incoming);
+	irq_restore(irqs);
+}
+
+/**
+ * This function empties the trace.
+*/
+void trace_clear() {
+	int irqs = irq_save();
+	recorded = 0;
+	irq_restore(irqs);
+}
+
+/**
+ * This function returns the name of an op code as recorded in the trace.
+ * 
+ * @param op_code - the op code
+ * @return its name
+*/
+static char* op_name(int op_code) {
+	switch(op_code) {
+		case EXIT:          return "EXIT";
+		case IDLE:          return "IDLE";
+		case READ:          return "READ";
+		case WRITE:         return "WRITE";
+		case SLEEP:         return "SLEEP";
+		case SPAWN:         return "SPAWN";
+		case TRACE_PREEMPT: return "PREEMPT";
+		default:            return "?";
+	}
+}
+
+/**
+ * This function prints the trace, oldest record first. Times are in microseconds, relative to
+ * the oldest record, along with the gap since the record before. Nothing is recorded while it
+ * runs, since printing goes through the dispatcher and would otherwise trace itself and
+ * overwrite the records not yet printed. The records are copied out TRACE_CHUNK at a time onto
+ * the stack, so each copy is short and nothing has to be allocated.
+*/
+void trace_dump() {
+	int irqs = irq_save();
+	dumping = 1;
+	u32int count = (recorded < TRACE_SIZE) ? recorded : TRACE_SIZE;
+	u32int first = recorded - count;
+	irq_restore(irqs);
+
+	println("");
+	if (count == 0) {
+		println("The trace is empty");
+		dumping = 0;
+		return;
+	}
+
+	print_column("TIME(us)", 12);
+	print_column("GAP(us)", 10);
+	print_column("OP", 9);
+	print_column("FROM", 21);
+	print_column("TO", 21);
+	println("READY");
+
+	TraceRecord chunk[TRACE_CHUNK];
+	u64int start = records[first & (TRACE_SIZE - 1)].tsc;
+	u64int last = start;
+	u32int i, j;
+	for (i = 0; i < count; i += TRACE_CHUNK) {
+		u32int n = (count - i < TRACE_CHUNK) ? count - i : TRACE_CHUNK;
+		irqs = irq_save();
+		for (j = 0; j < n; j++)
+			chunk[j] = records[(first + i + j) & (TRACE_SIZE - 1)];
+		irq_restore(irqs);
+
+		for (j = 0; j < n; j++) {
+			print_int_column(cycles_to_us(chunk[j].tsc - start), 12);
+			print_int_column(cycles_to_us(chunk[j].tsc - last), 10);
+			print_column(op_name(chunk[j].op_code), 9);
+			print_column(chunk[j].outgoing[0] ? chunk[j].outgoing : "-", 21);
+			print_column(chunk[j].incoming[0] ? chunk[j].incoming : "-", 21);
+			print_int(chunk[j].ready);
+			println("");
+			last = chunk[j].tsc;
+		}
+	}
+
+	if (recorded > TRACE_SIZE) {
+		print_int(recorded - TRACE_SIZE);
+		println(" older records were overwritten");
+	}
+
+	dumping = 0;
+}
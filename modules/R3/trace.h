@@ -0,0 +1,15 @@
+#ifndef TraceCompile
+#define TraceCompile
+
+#include <string.h>
+#include "../R2/PCB.h"
+
+#define TRACE_SIZE 256 ///< number of records the trace keeps, must be a power of two
+#define TRACE_CHUNK 8 ///< number of records trace_dump() copies out at a time, on the stack
+#define TRACE_PREEMPT -1 ///< op code recorded when the timer preempts a process
+
+void trace_switch(int op_code, PCB* outgoing, PCB* incoming, int ready);
+void trace_dump();
+void trace_clear();
+
+#endif
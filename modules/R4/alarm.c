@@ -2,8 +2,11 @@
 #include "alarm.h"
 #include "../R2/PCB.h"
 #include "../R2/Queue.h"
+#include "../R2/PCBTable.h"
 #include "../../include/string.h"
 #include "../R1/r1functions.h"
+#include "../R5/slab.h"
+#include "../R3/loadr3.h"
 
 
 #include "../../include/string.h"
@@ -36,6 +39,8 @@ int currentTime;
 
 struct alarmInfo* head = NULL;
 
+static Cache alarm_cache = CACHE_INIT("alarm", alarmInfo, NULL); // where alarms are allocated from
+
 
 /**
  * Returns the total number of seconds passed since midnight
@@ -74,7 +79,9 @@ void updateTimekeeping() {
 
 /**
  * Creates a new alarm with the specified time and message. Alarm data is inserted into a linked list of alarm data.
- *  A PCB is created for the alarm process if no other alarms are active.
+ *  A PCB is created for the alarm process if no other alarms are active. The list is shared with the Alarm process,
+ *  so it is changed with interrupts off, along with the check for the Alarm process: that one only exits with
+ *  interrupts off after finding the list empty, so either it sees the new alarm or it is gone and a new one is made.
  * 
  * @param time A time value from 00:00:00 to 23:59:59 
  * @param message A string of characters to be displayed when the alarm is triggered (30 char max)
@@ -106,7 +113,13 @@ void setupAlarm(char* time, char message[31])
 	}
 
 	//Set the values of the current struct
-	alarmInfo* info = sys_alloc_mem(sizeof(alarmInfo));
+	alarmInfo* info = cache_alloc(&alarm_cache);
+	if (info == NULL) {
+		println("\nNot enough memory to add the alarm");
+		return;
+	}
+
+	int irqs = irq_save();
 
 	// Set the timekeeping variables
   	updateTimekeeping();
@@ -134,90 +147,87 @@ void setupAlarm(char* time, char message[31])
 		i++;
 	}
 
-	//Place the current struct into the list of alarm structs
-	alarmInfo* current = head;
-	if(head == NULL)
-		head = info;
-	else
+	//Place the current struct at the end of the list of alarm structs
+	info -> next = NULL;
+	alarmInfo** last = &head;
+	while(*last != NULL)
+		last = &(*last) -> next;
+	*last = info;
+
+	int secondsFromNow = alarmTriggerTime - totalTimeSincePCBCreation;
+	if(lookup_pcb("Alarm") == NULL)
 	{
-		while(current != NULL)
-		{
-			if(current -> next == NULL)
-			{
-				current -> next = info;
-				break;
-			}
-			current = current -> next;
-		}
+		loadAlarm();
 	}
+	irq_restore(irqs);
+
 	print("\nAlarm successfully added with message '");
 	print(message);
 	print("' set for ");
-	print_int(alarmTriggerTime - totalTimeSincePCBCreation);
+	print_int(secondsFromNow);
 	println(" seconds from now.");
-
-
-	current = head;
-	while(current != NULL)
-	{
-		current = current -> next;
-	}
-
-	Queue* readyQueue = getReadyQueue();
-	if(!findPCBHelper(readyQueue, "Alarm"))
-	{
-		loadAlarm();
-	}
 }
 
 
 /**
  * This function runs as a seperate process. It iterates through the alarms to check to see if any are to be triggered.
- *  Triggered alarms are removed. If there are no more alarms, the process terminates.
+ *  Triggered alarms are taken out of the list with interrupts off, since setupAlarm() adds to it from the command
+ *  handler, and then printed and removed. If there are no more alarms, the process terminates, deciding so and
+ *  exiting with interrupts off so that setupAlarm() can't add an alarm in between (see setupAlarm()).
 */
 void checkAlarms() {
-	totalTimeSincePCBCreation = 0;
 	while(1) {
+		int irqs = irq_save();
+
   		// Set the timekeeping variables
   		updateTimekeeping();
 
-  		// Iterate through alarms
-  		alarmInfo* last = NULL;
-		alarmInfo* current = head;
-		while(current != NULL)
+  		// Take the triggered alarms out of the list, keeping them in order
+		alarmInfo* triggered = NULL;
+		alarmInfo** lastTriggered = &triggered;
+		alarmInfo** link = &head;
+		while(*link != NULL)
 		{
+			alarmInfo* current = *link;
 			if (current -> alarmTime <= totalTimeSincePCBCreation) {
-				print("\n!!!!!     Alarm triggered: '");
-				print(current -> alarmMessage);
-				println("'    !!!!!\n");
-				print("Current time:");
-				gettime();
-				
-				alarmInfo* nextAlarm = current -> next;
-				if (current == head)
-					head = nextAlarm;
-				last -> next = nextAlarm;
-
-				sys_free_mem(current);
-
-				last = current;
-				current = nextAlarm;
+				*link = current -> next;
+				current -> next = NULL;
+				*lastTriggered = current;
+				lastTriggered = &current -> next;
 			} else {
-				last = current;
-				current = current -> next;
+				link = &current -> next;
 			}
+		}
+		irq_restore(irqs);
+
+		while(triggered != NULL)
+		{
+			print("\n!!!!!     Alarm triggered: '");
+			print(triggered -> alarmMessage);
+			println("'    !!!!!\n");
+			print("Current time:");
+			gettime();
+
+			alarmInfo* nextAlarm = triggered -> next;
+			cache_free(&alarm_cache, triggered);
+			triggered = nextAlarm;
+		}
 
+		irqs = irq_save();
+		if (head == NULL) {
+			// still with interrupts off, so no alarm can be added before the process is gone
+   			totalTimeSincePCBCreation = 0;
+   			timeOfLastCheck = -1;
+   			sys_req(EXIT, DEFAULT_DEVICE, NULL, NULL);
+   			println("Error exiting alarm process");
 		}
-		if (head == NULL)
-			break;
+		irq_restore(irqs);
+
     	//println("All alarms checked");
-      	sys_req(IDLE, DEFAULT_DEVICE, NULL, NULL);
+    	// alarms are set to the second, so there's no need to look again any sooner
+    	int ms = 1000;
+      	sys_req(SLEEP, DEFAULT_DEVICE, NULL, &ms);
    	}
-   	totalTimeSincePCBCreation = 0;
-   	timeOfLastCheck = -1;
-   	//println("Exiting alarm process...");
-   	sys_req(EXIT, DEFAULT_DEVICE, NULL, NULL);
-   	println("Error exiting alarm process");
 }
 
 
@@ -227,18 +237,7 @@ void checkAlarms() {
 */
 void loadAlarm()
 {
-	PCB* alarmPCB = create_pcb("Alarm", User, 1); // Note: in the slides, it allows the user to specify the size of the stack when creating PCB, should we implement this?
-	Context* cp = (Context *)(alarmPCB -> stack_top);
-	memset(cp, 0, sizeof(Context));
-	cp -> fs = 0x10;
-	cp -> gs = 0x10;
-	cp -> ds = 0x10;
-	cp -> es = 0x10;
-	cp -> cs = 0x8;
-	cp -> ebp = (u32int)(alarmPCB -> stack_base);
-	cp -> esp = (u32int)(alarmPCB -> stack_top);
-	cp -> eip = (u32int) checkAlarms;
-	cp -> eflags = 0x202;
+	spawn_proc("Alarm", User, 1, checkAlarms, NULL, DEFAULT_STACK_SIZE);
 
 	//println("\nCreated process \"Alarm\"");
 }
@@ -1,5 +0,0 @@
-#include "../mpx_supt.h"
-#include "../R1/r1functions.h"
-
-void idle_proc(void);
-void idle_proc2(void);
\ No newline at end of file
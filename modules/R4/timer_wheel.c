@@ -0,0 +1,75 @@
+#include "timer_wheel.h"
+
+/**
+ * The timer wheel holds every sleeping process. A process waking at tick t is chained (through
+ * its sleep_next pointer) into slot t % WHEEL_SLOTS, so each tick only the one slot that is due
+ * needs to be looked at, however many processes are asleep. Deadlines more than a full turn of
+ * the wheel away simply stay in their slot until the turn in which they fall due.
+*/
+static PCB* slots[WHEEL_SLOTS];
+
+/**
+ * This function puts a process on the timer wheel. The caller is responsible for taking it off
+ * the CPU and blocking it; the wheel only unblocks it again once the deadline has passed.
+ * 
+ * @param pcb - the process going to sleep
+ * @param wake_tick - the timer tick at which it should be made ready
+*/
+void sleep_pcb(PCB* pcb, u32int wake_tick) {
+	int irqs = irq_save();
+	PCB** slot = &slots[wake_tick & (WHEEL_SLOTS - 1)];
+	(*pcb).wake_tick = wake_tick;
+	(*pcb).sleep_next = *slot;
+	*slot = pcb;
+	irq_restore(irqs);
+}
+
+/**
+ * This function takes a process off the timer wheel without waking it, e.g. when it is deleted.
+ * Nothing happens if the process isn't asleep.
+ * 
+ * @param pcb - the process to take off the wheel
+*/
+void cancel_sleep(PCB* pcb) {
+	int irqs = irq_save();
+	PCB** link = &slots[(*pcb).wake_tick & (WHEEL_SLOTS - 1)];
+	while (*link != NULL) {
+		if (*link == pcb) {
+			*link = (*pcb).sleep_next;
+			break;
+		}
+		link = &(**link).sleep_next;
+	}
+	(*pcb).sleep_next = NULL;
+	irq_restore(irqs);
+}
+
+/**
+ * This function is called by the timer interrupt on every tick. Each process in the slot for
+ * this tick whose deadline has arrived is taken off the wheel and unblocked (into the ready
+ * queue, or the suspended ready queue if it was suspended while asleep).
+ * 
+ * @param now - the current timer tick
+*/
+void advance_timer_wheel(u32int now) {
+	PCB** link = &slots[now & (WHEEL_SLOTS - 1)];
+	while (*link != NULL) {
+		PCB* pcb = *link;
+		if ((int)(now - (*pcb).wake_tick) >= 0) { // compare this way so tick wraparound is harmless
+			*link = (*pcb).sleep_next;
+			(*pcb).sleep_next = NULL;
+			unblock_pcb_ptr(pcb);
+		}
+		else
+			link = &(*pcb).sleep_next;
+	}
+}
+
+/**
+ * This function forgets every sleeping process, for shutdown.
+*/
+void clear_timer_wheel() {
+	int irqs = irq_save();
+	memset(slots, 0, sizeof(slots));
+	irq_restore(irqs);
+}
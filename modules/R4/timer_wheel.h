@@ -0,0 +1,13 @@
+#ifndef TimerWheelCompile
+#define TimerWheelCompile
+
+#include "../R2/PCB.h"
+
+#define WHEEL_SLOTS 64 ///< number of slots in the timer wheel, must be a power of two
+
+void sleep_pcb(PCB* pcb, u32int wake_tick);
+void cancel_sleep(PCB* pcb);
+void advance_timer_wheel(u32int now);
+void clear_timer_wheel();
+
+#endif
@@ -1,149 +1,525 @@
 #include "TestR5.h"
 #include "../R1/r1functions.h"
+#include "../R2/PCBTable.h"
 #include "../../include/mem/heap.h"
+#include <mem/paging.h>
+#include <mem/buddy.h>
+#include <string.h>
+#include <core/tsc.h>
 
-static CMCB* allocated_head;
-static CMCB* free_head;
+static heap_stats stats; /// running statistics, updated by add_cmcb()/remove_cmcb() and the allocation functions
+
+/**
+ * Free blocks are kept in segregated lists ("bins") by size, so allocation never walks the free
+ * blocks one by one. Bins below EXACT_BINS hold sizes in steps of BIN_STEP bytes, so any block in
+ * the bin of a (rounded up) request fits it. Above that, each bin holds one power of two of
+ * sizes. Bit b of bin_bitmap is set while bin b is non-empty, so the smallest non-empty bin that
+ * can satisfy a request is a single find-first-set away.
+*/
+static CMCB* bins[BIN_COUNT];
+static u32int bin_bitmap;
 
 static u32int memory_start;//When this wasn't static, there was some weird pointer stuff going on
-static u32int total_heap_size;
+static u32int total_heap_size; /// bytes in the heap, from the first CMCB to the end of the last LMCB
+static u32int heap_limit; /// the most total_heap_size may grow to
+
+/**
+ * Allocated blocks are kept in a list for each process that owns them, linked through the CMCBs'
+ * next/prev pointers (which free blocks use for their bins). The head of a process's list is in its
+ * PCB; blocks that belong to no process, like those allocated before the first dispatch, are kept in
+ * shared_blocks.
+*/
+static CMCB* shared_blocks;
+
+/**
+ * Blocks of whole pages (see allocate_pages()) keep their CMCBs here, one entry for each page of the page region a block may start
+ * at, rather than in the block itself, so a request of N pages takes N pages.
+*/
+static CMCB page_cmcbs[PAGE_REGION_PAGES];
+
+extern page_dir *kdir; //kernel page directory, which the heap's pages are mapped into
+
+static void write_lmcb(CMCB* cmcb);
 
 /**
- * This function sets up the initial information for the heap, including its CMCB and LMCB. It also initializes the head of the 
- * allocated and free lists for the CMCBs. It is meant to be run only once, at the beginning of the system's execution (like a 
- * constructor)
+ * This function finds the last block in the heap through the LMCB at the very end of the heap.
  * 
- * @param heap_size - the size (in bytes) to set the heap
+ * @return the CMCB of the last block, or NULL if the heap has no blocks yet
 */
-void init_heap(u32int heap_size)
+static CMCB* last_block()
 {
-	//Allocate memory for the heap
-	int heap_buffer = 500;
+	if(total_heap_size == 0)
+		return NULL;
 
-	memory_start = heap_buffer + kmalloc(heap_buffer + heap_size + sizeof(CMCB) + sizeof(LMCB));
-	total_heap_size = memory_start;
+	LMCB* last_lmcb = (void*)(memory_start + total_heap_size - sizeof(LMCB));
+	return (void*)((u32int)last_lmcb - last_lmcb -> size - sizeof(CMCB));
+}
 
-	//Initialize the CMCB
-	CMCB* new_cmcb = (void*)memory_start;//Check this line, this may not be the proper way to put this block in memory
-	new_cmcb -> type = Free;
-	new_cmcb -> address = memory_start;
-	new_cmcb -> size = heap_size;
-	//new_cmcb -> proc_name = NULL;
-	new_cmcb -> next = NULL;
-	new_cmcb -> prev = NULL;
+/**
+ * This function grows the heap so that it ends in a free block of at least the given size. Fresh frames are mapped into the pages
+ * right after the end of the heap. If the last block is free it is extended, since it only needs to grow by the difference;
+ * otherwise a new free block is made in the new pages. The heap never grows past its limit (see set_heap_limit()).
+ * 
+ * @param size - the size of free block needed at the end of the heap, not counting its CMCB and LMCB
+ * @return 1 if the heap now ends in a large enough free block, 0 if that would take it past its limit
+*/
+static int grow_heap(u32int size)
+{
+	CMCB* last_cmcb = last_block();
+	if(last_cmcb != NULL && last_cmcb -> type != Free)
+		last_cmcb = NULL;
 
-	//Initialize the LMCB
-	LMCB* new_lmcb = (void*)(memory_start + heap_size + sizeof(CMCB));
-	new_lmcb -> type = Free;
-	new_lmcb -> size = heap_size;
+	u32int needed = size + sizeof(CMCB) + sizeof(LMCB);
+	if(last_cmcb != NULL)
+	{
+		if(last_cmcb -> size >= size)
+			return 1;
+		needed = size - last_cmcb -> size;
+	}
 
-	//Initialize the pointers to the lists
-	allocated_head = NULL;
-	free_head = new_cmcb;
+	u32int grow = (needed + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+	if(grow > heap_limit - total_heap_size)
+		return 0;
 
+	u32int old_end = memory_start + total_heap_size;
+	u32int page;
+	for(page = old_end; page < old_end + grow; page += PAGE_SIZE)
+		new_frame(get_page(page, kdir, 0));
+	total_heap_size += grow;
+	stats.total_bytes = total_heap_size;
+	stats.grows++;
+
+	if(last_cmcb != NULL)
+	{
+		remove_cmcb(last_cmcb);
+		last_cmcb -> size += grow;
+	}
+	else
+	{
+		last_cmcb = (void*)old_end;
+		last_cmcb -> address = old_end;
+		last_cmcb -> size = grow - sizeof(CMCB) - sizeof(LMCB);
+	}
+	add_cmcb(last_cmcb, Free);
+	write_lmcb(last_cmcb);
+
+	return 1;
 }
 
 /**
- * This function is used to allocate a specific block of memory of a given size. Memory allocation for this system is performed using
- * a first-fit algorithm; that is, the first free block in the free list that is large enough for the allocated memory will be used to
- * allocate the memory. All memory blocks, allocated and free, include both a CMCB and an LMCB, which are used for accessing different
- * information about the blocks
+ * This function sets the most the heap may grow to. It can't be set below the heap's current size or above the size of the
+ * region the heap is mapped into (MPX_HEAP_SIZE).
  * 
- * @param bytes - the number of bytes to allocate
- * @return the memory address at which the allocated block was formed
+ * @param limit - the most bytes the heap may use, rounded down to whole pages
+ * @return the limit that was set
 */
-u32int allocate_mem(u32int bytes)
+u32int set_heap_limit(u32int limit)
 {
+	limit &= ~(PAGE_SIZE - 1);
+	if(limit > MPX_HEAP_SIZE)
+		limit = MPX_HEAP_SIZE;
+	if(limit < total_heap_size)
+		limit = total_heap_size;
+
+	heap_limit = limit;
+	stats.limit_bytes = limit;
+	return limit;
+}
 
-	//Determine the size of the full block for later use
-	u32int block_size = bytes + sizeof(CMCB) + sizeof(LMCB);
+/**
+ * This function sets up the initial information for the heap, including its CMCB and LMCB, and empties the free bins. The heap
+ * is mapped a page at a time into the MPX heap region (see MPX_HEAP_BASE), starting with enough pages for the given size; it
+ * grows from there when an allocation finds no block large enough. It is meant to be run only once, at the beginning of the
+ * system's execution (like a constructor), after paging has been enabled
+ * 
+ * @param heap_size - the size (in bytes) to set the heap
+ * @param limit - the most bytes the heap may grow to (see set_heap_limit())
+*/
+void init_heap(u32int heap_size, u32int limit)
+{
+	memory_start = MPX_HEAP_BASE;
+	total_heap_size = 0;
+
+	memset(&stats, 0, sizeof(stats));
+	memset(bins, 0, sizeof(bins));
+	bin_bitmap = 0;
+	shared_blocks = NULL;
+
+	set_heap_limit(limit);
+	if(!grow_heap(heap_size))
+		kpanic("The initial heap is larger than its limit");
+	stats.grows = 0;
+}
 
-	//Start the current CMCB to the head of the free list
-	CMCB* curr_cmcb = free_head;
-	while(curr_cmcb != NULL)
-	{
+/**
+ * This function returns the bin that holds free blocks of the given size: one bin per BIN_STEP
+ * bytes for small sizes, and one per power of two above that.
+ * 
+ * @param size - the size of a free block, not counting its CMCB and LMCB
+ * @return the index of its bin
+*/
+static int bin_of(u32int size)
+{
+	if(size < EXACT_BINS * BIN_STEP)
+		return size / BIN_STEP;
 
-		if(curr_cmcb -> size >= block_size)
-		{
-			//Swap the selected block from the Free to the Allocated list
-			add_cmcb(remove_cmcb(curr_cmcb), Allocated);
+	int bin = EXACT_BINS + (31 - __builtin_clz(size)) - 7; // 2^7 == EXACT_BINS * BIN_STEP
+	return (bin < BIN_COUNT) ? bin : BIN_COUNT - 1;
+}
 
-			//Keep track of the original size of the free block for later use
-			u32int old_size = curr_cmcb -> size;
+/**
+ * This function finds a free block of at least the given size. It takes the first block of the
+ * smallest non-empty bin whose blocks are all large enough, which takes constant time. Only if
+ * there is none does it search the one bin that may hold both smaller and large enough blocks.
+ * 
+ * @param size - the size needed, a multiple of BIN_STEP
+ * @return a free block large enough, or NULL if there is none
+*/
+static CMCB* find_free(u32int size)
+{
+	int bin = bin_of(size);
+	int fits = bin;
+	if(bin >= EXACT_BINS && (size & (size - 1)) != 0)
+		fits = bin + 1; // blocks in a power of two bin may be smaller than a size inside it
 
-			curr_cmcb -> size = bytes;
+	if(fits < BIN_COUNT && bin != BIN_COUNT - 1)
+	{
+		u32int candidates = bin_bitmap & ~((1u << fits) - 1);
+		if(candidates != 0)
+			return bins[__builtin_ffs(candidates) - 1];
+	}
 
-			//Create the new LMCB to go at the bottom of the allocated block
-			LMCB* new_lmcb = (void*)(curr_cmcb -> address + curr_cmcb -> size + sizeof(CMCB));
-			new_lmcb -> type = Allocated;
-			new_lmcb -> size = bytes;
+	//Nothing is certain to fit, so look through the bin the size itself falls in
+	CMCB* curr_cmcb = bins[bin];
+	while(curr_cmcb != NULL && curr_cmcb -> size < size)
+		curr_cmcb = curr_cmcb -> next;
+	return curr_cmcb;
+}
 
-			//Set up the new CMCB for the free section to go after the allocated section
-			CMCB* new_cmcb = (void*)(curr_cmcb -> address + block_size);
-			new_cmcb -> address = curr_cmcb -> address + block_size;
-			new_cmcb -> size = old_size - block_size;
-			new_cmcb -> next = NULL;
-			new_cmcb -> prev = NULL;
+/**
+ * This function writes the LMCB at the bottom of a block, so that the block after it can find
+ * the block's CMCB and whether it is free.
+ * 
+ * @param cmcb - the CMCB of the block
+*/
+static void write_lmcb(CMCB* cmcb)
+{
+	LMCB* lmcb = (void*)(cmcb -> address + sizeof(CMCB) + cmcb -> size);
+	lmcb -> type = cmcb -> type;
+	lmcb -> size = cmcb -> size;
+}
 
-			//Add the newly created CMCB to the free list
-			add_cmcb(new_cmcb, Free);
+/**
+ * This function rounds a request up to the size of block that is made for it: a multiple of BIN_STEP, and at least BIN_STEP.
+ * 
+ * @param bytes - the number of bytes requested
+ * @return the size of block to use
+*/
+static u32int round_size(u32int bytes)
+{
+	u32int size = (bytes + BIN_STEP - 1) & ~(BIN_STEP - 1);
+	return (size == 0) ? BIN_STEP : size;
+}
 
-			//Update the existing LMCB at the bottom of the free block
-			LMCB* free_lmcb = (void*)(new_cmcb -> address + sizeof(CMCB) + new_cmcb -> size);
-			free_lmcb -> type = Free;
-			free_lmcb -> size = new_cmcb -> size;
+/**
+ * This function finds the block that follows a block in the heap.
+ * 
+ * @param cmcb - the CMCB of a block
+ * @return the CMCB of the next block, or NULL if it is the last block in the heap
+*/
+static CMCB* next_block(CMCB* cmcb)
+{
+	u32int next_cmcb_addr = cmcb -> address + sizeof(CMCB) + cmcb -> size + sizeof(LMCB);
+	if(next_cmcb_addr < memory_start + total_heap_size)
+		return (void*)next_cmcb_addr;
+	return NULL;
+}
 
-			
-			return curr_cmcb->address + sizeof(CMCB);
-		}
+/**
+ * This function shrinks a block that is in neither the bins nor an owner's list to the given size, if what would be left over
+ * is large enough to be a block of its own. The leftover becomes a free block, merged with the block after it if that is free too.
+ * 
+ * @param cmcb - the CMCB of the block to shrink
+ * @param size - the size it needs to keep, a multiple of BIN_STEP
+*/
+static void split_block(CMCB* cmcb, u32int size)
+{
+	if(cmcb -> size < size + sizeof(CMCB) + sizeof(LMCB) + BIN_STEP)
+		return;
 
-		//Move to next CMCB in the list
-		curr_cmcb = curr_cmcb -> next;
+	CMCB* new_cmcb = (void*)(cmcb -> address + sizeof(CMCB) + size + sizeof(LMCB));
+	new_cmcb -> address = (u32int)new_cmcb;
+	new_cmcb -> size = cmcb -> size - size - sizeof(CMCB) - sizeof(LMCB);
+	cmcb -> size = size;
 
+	CMCB* after = next_block(new_cmcb);
+	if(after != NULL && after -> type == Free)
+	{
+		remove_cmcb(after);
+		after -> magic = 0;
+		new_cmcb -> size += sizeof(CMCB) + after -> size + sizeof(LMCB);
 	}
-	println("\nNo sufficiently large memory blocks are available");
-	return NULL;
+
+	add_cmcb(new_cmcb, Free);
+	write_lmcb(new_cmcb);
 }
 
 /**
- * This function is used to free an allocated block of memory. The freed block of memory will be merged with any adjacent free blocks to
- * form larger free blocks. Free blocks and allocated blocks each use CMCBs and LMCBs to access important data about them
+ * This function returns the entry of page_cmcbs for a block of whole pages.
  * 
- * @param ipaddr - The address of the block of allocated memory to free (must be a valid address of an allocated block)
- * @return 1 if the allocated block is successsfully freed, and 0 otherwise
+ * @param address - the address of the block, in the page region
+ * @return its CMCB
 */
-int free_mem(void* ipaddr)
+static CMCB* page_cmcb(u32int address)
 {
-	u32int input_address = (u32int)ipaddr - sizeof(CMCB);
+	return &page_cmcbs[(address - PAGE_REGION_BASE) / PAGE_SIZE];
+}
 
-	//If there is no allocated memory, then the free function will not do anything
-	if(allocated_head == NULL)
+/**
+ * This function returns the address the memory of a block starts at, which is what allocate_mem() returned for it.
+ * 
+ * @param cmcb - the CMCB of the block
+ * @return the address of its memory
+*/
+static u32int block_memory(CMCB* cmcb)
+{
+	if(cmcb -> magic == CMCB_PAGES)
+		return cmcb -> address; // its CMCB is in page_cmcbs
+	return cmcb -> address + sizeof(CMCB);
+}
+
+/**
+ * This function finds the CMCB of an allocated block from the address that was returned for it. The CMCB sits right before
+ * the address, so this takes constant time. It is checked before it is trusted: the address has to be in the heap, and the CMCB
+ * has to record its own address and carry the magic value of an allocated block. A block of whole pages has its CMCB in
+ * page_cmcbs instead, and the page region has to have a block in use starting at the address (see is_page_block()).
+ * 
+ * @param ipaddr - the address of a block, as returned by allocate_mem()
+ * @return the block's CMCB, or NULL (after printing why) if it isn't a valid allocated block
+*/
+static CMCB* allocated_cmcb(void* ipaddr)
+{
+	if(is_page_block((u32int)ipaddr))
 	{
-		println("\nThere is no allocated memory");
-		return 0;
+		CMCB* page_block = page_cmcb((u32int)ipaddr);
+		if(page_block -> magic == CMCB_PAGES && page_block -> address == (u32int)ipaddr)
+			return page_block;
+		println("\nERROR: There is no CMCB at the given address");
+		return NULL;
 	}
 
-	//Looping through the allocated list to find the CMCB for the memory to free
-	CMCB* curr_cmcb = allocated_head;
-	while(curr_cmcb != NULL)
+	//The CMCB sits right before the memory it describes
+	u32int input_address = (u32int)ipaddr - sizeof(CMCB);
+	CMCB* curr_cmcb = (void*)input_address;
+
+	//Make sure there really is an allocated block there before touching anything
+	if((u32int)ipaddr < memory_start + sizeof(CMCB) || input_address + sizeof(CMCB) > memory_start + total_heap_size
+		|| curr_cmcb -> address != input_address || curr_cmcb -> type != Allocated)
 	{
-		if(curr_cmcb -> address == input_address)
-		{
-			break;
-		}
+		println("\nERROR: There is no CMCB at the given address");
+		return NULL;
+	}
+	if(curr_cmcb -> magic != CMCB_ALLOCATED)
+	{
+		if(curr_cmcb -> magic == CMCB_FREE)
+			println("\nERROR: The block at the given address is already free");
+		else
+			println("\nERROR: There is no CMCB at the given address");
+		return NULL;
+	}
 
-		curr_cmcb = curr_cmcb -> next;
+	return curr_cmcb;
+}
+
+/**
+ * This function returns the head of the list of allocated blocks a process owns.
+ * 
+ * @param owner - the process, or NULL for blocks that belong to no process
+ * @return a pointer to the head of its list
+*/
+static CMCB** owned_list(struct PCB* owner)
+{
+	if(owner == NULL)
+		return &shared_blocks;
+	return &(*owner).allocations;
+}
+
+/**
+ * This function pushes an allocated block onto the front of its owner's list.
+ * 
+ * @param cmcb - the CMCB of the block, with its owner set
+*/
+static void link_owned(CMCB* cmcb)
+{
+	CMCB** list = owned_list(cmcb -> owner);
+	cmcb -> prev = NULL;
+	cmcb -> next = *list;
+	if(*list != NULL)
+		(*list) -> prev = cmcb;
+	*list = cmcb;
+}
+
+/**
+ * This function takes an allocated block out of its owner's list.
+ * 
+ * @param cmcb - the CMCB of the block
+*/
+static void unlink_owned(CMCB* cmcb)
+{
+	if(cmcb -> next != NULL)
+		cmcb -> next -> prev = cmcb -> prev;
+
+	if(cmcb -> prev != NULL)
+		cmcb -> prev -> next = cmcb -> next;
+	else
+		*owned_list(cmcb -> owner) = cmcb -> next;
+
+	cmcb -> next = NULL;
+	cmcb -> prev = NULL;
+}
+
+/**
+ * This function sets the owner of a block that is in neither the bins nor an owner's list, recording the owner's name in the CMCB.
+ * 
+ * @param cmcb - the CMCB of the block
+ * @param owner - the process that owns it, or NULL if it belongs to no process
+*/
+static void tag_owner(CMCB* cmcb, struct PCB* owner)
+{
+	cmcb -> owner = owner;
+	if(owner == NULL)
+		cmcb -> proc_name[0] = '\0';
+	else
+		strcpy(cmcb -> proc_name, (*owner).name);
+}
+
+/**
+ * This function allocates a block of whole pages from the page region (see page_alloc()) for a large request, so large blocks
+ * don't split up the heap that small ones come from. The block is all memory: its CMCB is in page_cmcbs, and it has no LMCB,
+ * since it has no neighbours to merge with (the buddy allocator does that for the address space).
+ * 
+ * @param bytes - the number of bytes to allocate
+ * @param owner - the process the block belongs to, or NULL if it belongs to no process
+ * @return the memory address at which the allocated block was formed, or NULL if there is no room
+*/
+static u32int allocate_pages(u32int bytes, struct PCB* owner)
+{
+	u32int mapped = (bytes + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+	u32int address = page_alloc(mapped);
+	if(address == NULL)
+	{
+		stats.failed_allocs++;
+		klogv("No sufficiently large memory blocks are available");
+		return NULL;
 	}
 
-	//Determine whether an actual CMCB was found or not
+	CMCB* new_cmcb = page_cmcb(address);
+	new_cmcb -> magic = CMCB_PAGES;
+	new_cmcb -> type = Allocated;
+	new_cmcb -> address = address;
+	new_cmcb -> size = mapped;
+	tag_owner(new_cmcb, owner);
+	link_owned(new_cmcb);
+	stats.page_blocks++;
+	stats.page_bytes += mapped;
+	stats.allocs++;
+
+	return address;
+}
+
+/**
+ * This function frees a block of whole pages made by allocate_pages(), unmapping it.
+ * 
+ * @param cmcb - the CMCB of the block, in page_cmcbs
+*/
+static void free_pages(CMCB* cmcb)
+{
+	unlink_owned(cmcb);
+	stats.page_blocks--;
+	stats.page_bytes -= cmcb -> size;
+	stats.frees++;
+
+	cmcb -> magic = 0;
+	page_free(cmcb -> address);
+}
+
+/**
+ * This function allocates a block of the given size for the given owner (see allocate_mem()).
+ * 
+ * @param bytes - the number of bytes to allocate
+ * @param owner - the process the block belongs to, or NULL if it belongs to no process
+ * @return the memory address at which the allocated block was formed, or NULL if there is no room
+*/
+static u32int allocate_block(u32int bytes, struct PCB* owner)
+{
+	if(bytes >= LARGE_ALLOC)
+		return allocate_pages(bytes, owner);
+
+	u32int size = round_size(bytes);
+
+	CMCB* curr_cmcb = find_free(size);
+	if(curr_cmcb == NULL && grow_heap(size))
+		curr_cmcb = find_free(size);
 	if(curr_cmcb == NULL)
 	{
-		println("\nERROR: There is no CMCB at the given address");
+		stats.failed_allocs++;
+		klogv("No sufficiently large memory blocks are available");
+		return NULL;
+	}
+	remove_cmcb(curr_cmcb);
+
+	//Split off the rest of the block, unless it is too small to be a block of its own
+	split_block(curr_cmcb, size);
+
+	tag_owner(curr_cmcb, owner);
+	add_cmcb(curr_cmcb, Allocated);
+	write_lmcb(curr_cmcb);
+	stats.allocs++;
+
+	return curr_cmcb->address + sizeof(CMCB);
+}
+
+/**
+ * This function is used to allocate a specific block of memory of a given size. The request is
+ * rounded up to a multiple of BIN_STEP and served from the smallest free block bin that can hold
+ * it (see find_free()), so the time it takes doesn't grow with the number of free blocks. Whatever
+ * the block has left over, if it is enough to make a block of its own, is split off and returned
+ * to the bins. All memory blocks, allocated and free, include both a CMCB and an LMCB, which are
+ * used for accessing different information about the blocks. Requests of LARGE_ALLOC bytes or
+ * more get a block of whole pages instead (see allocate_pages()). The block belongs to the running
+ * process, and is freed along with the rest of its blocks when it ends (see free_owned_mem()). When there is no room, that is
+ * only logged (see klogv()): this is called from inside sys_call, to make PCBs for SPAWN, where printing would make a system call
+ * 
+ * @param bytes - the number of bytes to allocate
+ * @return the memory address at which the allocated block was formed, or NULL if there is no room
+*/
+u32int allocate_mem(u32int bytes)
+{
+	return allocate_block(bytes, get_running_pcb());
+}
+
+/**
+ * This function is used to free an allocated block of memory. The block's CMCB is found directly in front of the address and checked
+ * by its magic value, and the freed block of memory will be merged with any adjacent free blocks to form larger free blocks, which it
+ * finds through the LMCB just before it and the CMCB just after it. All of this takes constant time, however many blocks there are.
+ * Free blocks and allocated blocks each use CMCBs and LMCBs to access important data about them
+ * 
+ * @param ipaddr - The address of the block of allocated memory to free (must be a valid address of an allocated block)
+ * @return 1 if the allocated block is successsfully freed, and 0 otherwise
+*/
+int free_mem(void* ipaddr)
+{
+	CMCB* curr_cmcb = allocated_cmcb(ipaddr);
+	if(curr_cmcb == NULL)
 		return 0;
+
+	if(curr_cmcb -> magic == CMCB_PAGES)
+	{
+		free_pages(curr_cmcb);
+		return 1;
 	}
 
-	//Move the CMCB from the allocated list to the free list
-	add_cmcb(remove_cmcb(curr_cmcb), Free);
+	remove_cmcb(curr_cmcb);
 
 	//Get the address location for the lmcb of the previous memory block
 	u32int prev_lmcb_addr = curr_cmcb -> address - sizeof(LMCB);
@@ -161,87 +537,71 @@ int free_mem(void* ipaddr)
 			//Find the CMCB for the block based on the size given in the LMCB
 			CMCB* prev_cmcb = (void*)(prev_lmcb_addr - (prev_lmcb -> size + sizeof(CMCB)));
 
+			//Take it out of its bin, since it is about to change size
+			remove_cmcb(prev_cmcb);
+			curr_cmcb -> magic = 0; // now just part of the previous block
+
 			//Reset the size so that it encompasses the entire free block now
 			prev_cmcb -> size = prev_cmcb -> size + sizeof(LMCB) + sizeof(CMCB) + curr_cmcb -> size;
 
-			//Remove the old CMCB from the free queue as it is no longer necessary
-			remove_cmcb(curr_cmcb);
-
 			//Reassign the curr_cmcb pointer so it points to the new CMCB
 			curr_cmcb = prev_cmcb;
 		}
 
 	}
 
-	//Calculate the address of the CMCB for the next memory block after the current block
-	u32int next_cmcb_addr = curr_cmcb -> address + sizeof(CMCB) + curr_cmcb -> size + sizeof(LMCB);
-
-	//Determine whether the address of this CMCB appears within the bounds of the heap
-	if(next_cmcb_addr < memory_start + sizeof(CMCB) + total_heap_size + sizeof(LMCB))
+	//Find the CMCB for the next memory block after the current block, if this isn't the last block in the heap
+	CMCB* next_cmcb = next_block(curr_cmcb);
+	if(next_cmcb != NULL)
 	{
-
-		//Find the CMCB based on the previously calculated address
-		CMCB* next_cmcb = (void*)next_cmcb_addr;
-
 		//Determine whether the next block is a free block or not
 		if(next_cmcb -> type == Free)
 		{
+			//Remove the newly found CMCB from its bin as it is no longer needed
+			remove_cmcb(next_cmcb);
+			next_cmcb -> magic = 0;
+
 			//Reassign the size of the current CMCB so that it encompasses the adjacent memory block as well
 			curr_cmcb -> size = curr_cmcb -> size + sizeof(LMCB) + sizeof(CMCB) + next_cmcb -> size;
-
-			//Remove the newly found CMCB from the free list as it is no longer needed
-			remove_cmcb(next_cmcb);
 		}
 	}
 
-	//Reset the size for the LMCB at the bottom of the memory block so it can be used by future calls of free
-	LMCB* this_lmcb = (void*)(curr_cmcb -> address + sizeof(CMCB) + curr_cmcb -> size);
-	this_lmcb -> type = Free;
-	this_lmcb -> size = curr_cmcb -> size;
+	//File the merged block under its new size, and reset the LMCB at the bottom of the memory block so it can be used by future calls of free
+	add_cmcb(curr_cmcb, Free);
+	write_lmcb(curr_cmcb);
+	stats.frees++;
 
 	return 1;
 }
 
 /**
  * This function prints out either all free blocks or all allocated blocks. For each block of memory, it will print out the
- * type of block it is, the address of the block, and the size of the block.
+ * type of block it is, the address of the block, and the size of the block. Blocks are found by walking the heap from one
+ * block to the next, so they are listed in order of address.
  * 
- * @param the_type - an enum type (Allocated or Free), indicating whether to print the free or allocated list
+ * @param the_type - an enum type (Allocated or Free), indicating whether to print the free or allocated blocks
 */
 void show_cmcbs(enum memory_type the_type)
 {
-	int error_save = 0;
 	char number[12];
 
-	CMCB* curr_cmcb;
-	if(the_type == Allocated)
-	{
-		curr_cmcb = allocated_head;
-	}
-	else
-	{
-		curr_cmcb = free_head;
-	}
-
 	println("");
-	while(curr_cmcb != NULL)
+	u32int address = memory_start;
+	while(address < memory_start + total_heap_size)
 	{
+		CMCB* curr_cmcb = (void*)address;
+		address += sizeof(CMCB) + curr_cmcb -> size + sizeof(LMCB);
+		if(curr_cmcb -> type != the_type)
+			continue;
+
 		print("{ ");
 		if(curr_cmcb -> type == Allocated)
 		{
 			print("Type=Allocated,");
 		}
-		else if(curr_cmcb -> type == Free)
-		{
-			print("Type=Free,");
-		}
-		else if(curr_cmcb -> type == NULL)
-		{
-			print("Type=NULL,");
-		}
 		else
 		{
-			print("Type=Unknown,");
+			print("Type=Free,");
 		}
 
 		print(" Address=");
@@ -253,126 +613,408 @@ void show_cmcbs(enum memory_type the_type)
 
 		bad_itoa(number, curr_cmcb -> size);
 		print(number);
-		println(" }");
 
-		curr_cmcb = curr_cmcb -> next;
-		if(error_save > 1000)
+		if(curr_cmcb -> type == Allocated)
 		{
-			println("\nEXITING THE FUNCTION: Infinite loop suspected");
-			return;
+			print(", Owner=");
+			print(curr_cmcb -> owner == NULL ? "none" : curr_cmcb -> proc_name);
 		}
-		error_save++;
+		println(" }");
 	}
 }
 
 /**
- * This function determines whether the heap is empty. The heap is considered empty if there are no allocated blocks
- * in the heap.
+ * This function moves an allocated block to a new block of the given size, for the same owner, copying as much of its contents
+ * as fits and freeing it.
  * 
- * @return 1 is the heap contains no allocated blocks, and 0 otherwise
+ * @param cmcb - the CMCB of the block
+ * @param bytes - the number of bytes the new block needs to hold
+ * @return the address of the new block, or NULL if there is no room, in which case the old block is left as it was
 */
-int is_empty()
+static u32int move_block(CMCB* cmcb, u32int bytes)
 {
-	if(allocated_head == NULL)
-		return 1;
-	return 0;
+	u32int new_address = allocate_block(bytes, cmcb -> owner);
+	if(new_address == NULL)
+		return NULL;
+
+	void* old_address = (void*)block_memory(cmcb);
+	memcpy((void*)new_address, old_address, bytes < cmcb -> size ? bytes : cmcb -> size);
+	free_mem(old_address);
+	stats.allocs--; // the move is counted as a reallocation, not an allocation and a free
+	stats.frees--;
+	return new_address;
 }
 
 /**
- * This function is used to add a CMCB to either the allocated or the free list, depending on what type it is. Regardless of the list
- * CMCBs are added to the list based on their address (so the addresses of each are sorted in increasing order)
+ * This function changes the size of an allocated block, keeping its contents (up to the smaller of the two sizes). Wherever it can,
+ * the block is resized where it is: shrinking splits off the end as a free block, and growing absorbs the free block that follows
+ * it, if there is one and it is large enough. A block of whole pages stays where it is as long as it is large enough and the new
+ * size is still LARGE_ALLOC or more. Otherwise a new block is allocated, the contents copied and the old block freed.
  * 
- * @param new_cmcb - the new CMCB to add to the list
- * @param the_type - an enum type (Allocated or Free) indicating which of the two lists to add the CMCB to
+ * @param ipaddr - the address of the block to resize, or NULL to allocate a new block
+ * @param bytes - the number of bytes the block needs to hold
+ * @return the address of the resized block (which may have moved), or NULL if there is no room, in which case the old block is
+ * left as it was
 */
-void add_cmcb(CMCB* new_cmcb, enum memory_type new_type)
+u32int reallocate_mem(void* ipaddr, u32int bytes)
 {
-	CMCB* curr_cmcb;
-	new_cmcb -> type = new_type;
-	if(new_type == Allocated)
+	if(ipaddr == NULL)
+		return allocate_mem(bytes);
+
+	CMCB* curr_cmcb = allocated_cmcb(ipaddr);
+	if(curr_cmcb == NULL)
+		return NULL;
+
+	u32int size = round_size(bytes);
+	stats.reallocs++;
+
+	//Large blocks are whole pages and small ones are in the heap, so a block that changes sides has to move
+	if(curr_cmcb -> magic == CMCB_PAGES)
 	{
-		if(allocated_head == NULL)
-		{
-			allocated_head = new_cmcb;
-			new_cmcb -> next = NULL;
-			new_cmcb -> prev = NULL;
-			return;
-		}
-		curr_cmcb = allocated_head;
+		if(bytes < LARGE_ALLOC || bytes > curr_cmcb -> size)
+			return move_block(curr_cmcb, bytes);
+		stats.reallocs_in_place++;
+		return (u32int)ipaddr;
+	}
+	if(bytes >= LARGE_ALLOC)
+		return move_block(curr_cmcb, bytes);
+
+	CMCB* next_cmcb = next_block(curr_cmcb);
+
+	//Grow into the next block if it is free and there is enough of it
+	if(size > curr_cmcb -> size && next_cmcb != NULL && next_cmcb -> type == Free
+		&& curr_cmcb -> size + sizeof(LMCB) + sizeof(CMCB) + next_cmcb -> size >= size)
+	{
+		remove_cmcb(curr_cmcb); // taken out and put back, to keep the statistics right
+		remove_cmcb(next_cmcb);
+		next_cmcb -> magic = 0;
+		curr_cmcb -> size += sizeof(LMCB) + sizeof(CMCB) + next_cmcb -> size;
+	}
+	else if(size <= curr_cmcb -> size)
+	{
+		remove_cmcb(curr_cmcb);
 	}
 	else
 	{
-		if(free_head == NULL)
-		{
-			free_head = new_cmcb;
-			new_cmcb -> next = NULL;
-			new_cmcb -> prev = NULL;
-			return;
-		}
-		curr_cmcb = free_head;
+		//There is no room where it is, so move it
+		return move_block(curr_cmcb, bytes);
 	}
 
-	if(curr_cmcb -> address > new_cmcb -> address)
+	split_block(curr_cmcb, size);
+	add_cmcb(curr_cmcb, Allocated);
+	write_lmcb(curr_cmcb);
+	stats.reallocs_in_place++;
+
+	return (u32int)ipaddr;
+}
+
+/**
+ * This function gives an allocated block to another owner. Memory that outlives the process that allocated it, like the slabs of
+ * the object caches, should be given to no process so it isn't freed when that process ends.
+ * 
+ * @param ipaddr - the address of the block, as returned by allocate_mem()
+ * @param owner - the process it now belongs to, or NULL if it belongs to no process
+ * @return 1 if the owner was changed, and 0 if the address isn't that of an allocated block
+*/
+int set_mem_owner(void* ipaddr, struct PCB* owner)
+{
+	int irqs = irq_save(); // the block could be freed from under us otherwise
+	CMCB* curr_cmcb = allocated_cmcb(ipaddr);
+	if(curr_cmcb != NULL)
 	{
-		curr_cmcb -> prev = new_cmcb;
-		new_cmcb -> next = curr_cmcb;
-		if(new_type == Allocated)
-		{
-			allocated_head = new_cmcb;
-		}
-		else
-			free_head = new_cmcb;
-		return;
+		unlink_owned(curr_cmcb);
+		tag_owner(curr_cmcb, owner);
+		link_owned(curr_cmcb);
+	}
+	irq_restore(irqs);
+
+	return curr_cmcb != NULL;
+}
+
+/**
+ * This function frees every block a process owns, in one pass over its list. It is called when the process ends, so whatever
+ * it didn't free itself doesn't stay allocated forever.
+ * 
+ * @param owner - the process that ended
+ * @return the number of blocks freed
+*/
+u32int free_owned_mem(struct PCB* owner)
+{
+	if(owner == NULL)
+		return 0; // the blocks of no process are never freed in bulk
+
+	u32int freed = 0;
+	int irqs = irq_save(); // processes end both by commands and in the dispatcher
+	while((*owner).allocations != NULL)
+	{
+		CMCB* curr_cmcb = (*owner).allocations;
+		stats.reclaimed_bytes += curr_cmcb -> size;
+		free_mem((void*)block_memory(curr_cmcb));
+		freed++;
 	}
+	stats.reclaimed_blocks += freed;
+	irq_restore(irqs);
 
-	while(curr_cmcb -> next != NULL)
+	return freed;
+}
+
+/**
+ * This function prints the blocks owned by a process: the address and size of each (up to SHOW_OWNED_MAX of them), and how many
+ * blocks and bytes it owns in all. The list is copied with interrupts off, so it is consistent even though printing takes a while.
+ * 
+ * @param name - the name of the process
+*/
+void show_owned_mem(char* name)
+{
+	u32int addresses[SHOW_OWNED_MAX];
+	u32int sizes[SHOW_OWNED_MAX];
+	u32int count = 0;
+	u32int bytes = 0;
+
+	int irqs = irq_save();
+	PCB* owner = lookup_pcb(name);
+	if(owner == NULL)
 	{
-		if(curr_cmcb -> next -> address > new_cmcb -> address)
+		irq_restore(irqs);
+		print("\nA PCB named \"");
+		print(name);
+		println("\" does not exist");
+		return;
+	}
+	CMCB* curr_cmcb = (*owner).allocations;
+	while(curr_cmcb != NULL)
+	{
+		if(count < SHOW_OWNED_MAX)
 		{
-			new_cmcb -> next = curr_cmcb -> next;
-			new_cmcb -> prev = curr_cmcb;
-			new_cmcb -> next -> prev = new_cmcb;
-			curr_cmcb -> next = new_cmcb;
-			return;
+			addresses[count] = block_memory(curr_cmcb);
+			sizes[count] = curr_cmcb -> size;
 		}
+		count++;
+		bytes += curr_cmcb -> size;
 		curr_cmcb = curr_cmcb -> next;
 	}
+	irq_restore(irqs);
 
-	curr_cmcb -> next = new_cmcb;
-	new_cmcb -> prev = curr_cmcb;
+	println("");
+	u32int i;
+	for(i = 0; i < count && i < SHOW_OWNED_MAX; i++)
+	{
+		print("{ Address=");
+		print_int(addresses[i]);
+		print(", Size=");
+		print_int(sizes[i]);
+		println(" }");
+	}
+	if(count > SHOW_OWNED_MAX)
+	{
+		print("... and ");
+		print_int(count - SHOW_OWNED_MAX);
+		println(" more");
+	}
+
+	print(name);
+	print(" owns ");
+	print_int(count);
+	print(" blocks, ");
+	print_int(bytes);
+	println(" bytes");
 }
 
 /**
- * This function is used to remove a CMCB from either the free or allocated list (whichever it is located in). It determines which
- * list to remove the CMCB on based on the value stored in the CMCBs type parameter
+ * This function copies the heap's statistics. They are all kept up to date as blocks come and go, except for two. The free space
+ * of the page region is asked for (see get_page_region_stats()). The size of the largest free block isn't kept at all: it is found
+ * by walking the blocks of the highest non-empty bin, and no other bin, since every block there is larger than any block in a lower
+ * bin. That walk takes time in proportion to the number of blocks in that one bin.
  * 
- * @param old_cmcb - the CMCB to remove from the list
+ * @param copy - where to copy the statistics
 */
-CMCB* remove_cmcb(CMCB* old_cmcb)
+void get_heap_stats(heap_stats* copy)
 {
-	enum memory_type old_type = old_cmcb -> type;
+	*copy = stats;
+	get_page_region_stats(&(*copy).region_free_pages, &(*copy).region_largest_free);
+	(*copy).largest_free = 0;
+	if(bin_bitmap == 0)
+		return;
 
-	if(old_cmcb -> next != NULL)
+	CMCB* curr_cmcb = bins[31 - __builtin_clz(bin_bitmap)];
+	while(curr_cmcb != NULL)
 	{
-		old_cmcb -> next -> prev = old_cmcb -> prev;
+		if(curr_cmcb -> size > (*copy).largest_free)
+			(*copy).largest_free = curr_cmcb -> size;
+		curr_cmcb = curr_cmcb -> next;
 	}
+}
 
-	if(old_cmcb -> prev != NULL)
+/**
+ * This function prints a number of bytes as a line of the heap statistics.
+ * 
+ * @param label - what the number is
+ * @param bytes - the number of bytes
+*/
+static void print_bytes(char* label, u32int bytes)
+{
+	print(label);
+	print_int(bytes);
+	println(" bytes");
+}
+
+/**
+ * This function prints the heap's statistics: how much of it is used and free, how fragmented the free memory is, and how many
+ * allocations and frees there have been. External fragmentation is the share of free memory that isn't in the largest free block,
+ * so 0% means all of it could be handed out in one allocation.
+*/
+void show_heap_stats()
+{
+	heap_stats copy;
+	int irqs = irq_save(); // allocations happen in every process
+	get_heap_stats(&copy);
+	irq_restore(irqs);
+
+	println("");
+	print("Heap size: ");
+	print_int(copy.total_bytes);
+	print(" bytes, limit ");
+	print_int(copy.limit_bytes);
+	print(" bytes, grown ");
+	print_int(copy.grows);
+	println(" times");
+	print_bytes("Used: ", copy.used_bytes);
+	print_bytes("Free: ", copy.free_bytes);
+	print_bytes("Control blocks: ", copy.total_bytes - copy.used_bytes - copy.free_bytes);
+	print_bytes("Peak used: ", copy.peak_used_bytes);
+	print_bytes("Largest free block: ", copy.largest_free);
+
+	print("Blocks: ");
+	print_int(copy.allocated_blocks);
+	print(" allocated, ");
+	print_int(copy.free_blocks);
+	println(" free");
+
+	u32int permille = 0;
+	if(copy.free_bytes != 0)
+		permille = (u32int)div64((u64int)(copy.free_bytes - copy.largest_free) * 1000, copy.free_bytes);
+	print("External fragmentation: ");
+	print_int(permille / 10);
+	print(".");
+	print_int(permille % 10);
+	println("%");
+
+	print("Allocations: ");
+	print_int(copy.allocs);
+	print(" (");
+	print_int(copy.failed_allocs);
+	print(" failed), frees: ");
+	print_int(copy.frees);
+	println("");
+
+	print("Reallocations: ");
+	print_int(copy.reallocs);
+	print(" (");
+	print_int(copy.reallocs_in_place);
+	println(" in place)");
+
+	print("Page blocks: ");
+	print_int(copy.page_blocks);
+	print(" (");
+	print_int(copy.page_bytes);
+	print(" bytes), page region: ");
+	print_int(copy.region_free_pages);
+	print(" pages free, largest free block ");
+	print_int(copy.region_largest_free);
+	println(" pages");
+
+	print("Reclaimed from ended processes: ");
+	print_int(copy.reclaimed_blocks);
+	print(" blocks, ");
+	print_int(copy.reclaimed_bytes);
+	println(" bytes");
+}
+
+/**
+ * This function determines whether the heap is empty. The heap is considered empty if there are no allocated blocks
+ * in the heap.
+ * 
+ * @return 1 is the heap contains no allocated blocks, and 0 otherwise
+*/
+int is_empty()
+{
+	if(stats.allocated_blocks == 0 && stats.page_blocks == 0)
+		return 1;
+	return 0;
+}
+
+/**
+ * This function is used to mark a CMCB as either allocated or free, depending on the type given. Free CMCBs are pushed onto the
+ * front of the bin for their size, and allocated CMCBs onto the front of their owner's list (so their owner has to be set first).
+ * Either way this takes constant time
+ * 
+ * @param new_cmcb - the new CMCB to add to the list
+ * @param the_type - an enum type (Allocated or Free) indicating which of the two lists to add the CMCB to
+*/
+void add_cmcb(CMCB* new_cmcb, enum memory_type new_type)
+{
+	new_cmcb -> type = new_type;
+	new_cmcb -> next = NULL;
+	new_cmcb -> prev = NULL;
+
+	if(new_type == Allocated)
 	{
-		old_cmcb -> prev -> next = old_cmcb -> next;
+		new_cmcb -> magic = CMCB_ALLOCATED;
+		link_owned(new_cmcb);
+		stats.allocated_blocks++;
+		stats.used_bytes += new_cmcb -> size;
+		if(stats.used_bytes > stats.peak_used_bytes)
+			stats.peak_used_bytes = stats.used_bytes;
+		return;
+	}
+
+	int bin = bin_of(new_cmcb -> size);
+	new_cmcb -> magic = CMCB_FREE;
+	new_cmcb -> next = bins[bin];
+	if(bins[bin] != NULL)
+		bins[bin] -> prev = new_cmcb;
+	bins[bin] = new_cmcb;
+	bin_bitmap |= 1u << bin;
+	stats.free_blocks++;
+	stats.free_bytes += new_cmcb -> size;
+}
+
+/**
+ * This function is used to take a CMCB out of its free bin or its owner's list (whichever it is in), in constant time. It
+ * determines which based on the value stored in the CMCBs type parameter
+ * 
+ * @param old_cmcb - the CMCB to remove from the list
+*/
+CMCB* remove_cmcb(CMCB* old_cmcb)
+{
+	if(old_cmcb -> type == Allocated)
+	{
+		stats.allocated_blocks--;
+		stats.used_bytes -= old_cmcb -> size;
+		unlink_owned(old_cmcb);
 	}
 	else
 	{
-		if(old_type == Allocated)
-			allocated_head = old_cmcb -> next;
+		stats.free_blocks--;
+		stats.free_bytes -= old_cmcb -> size;
+
+		if(old_cmcb -> next != NULL)
+			old_cmcb -> next -> prev = old_cmcb -> prev;
+
+		if(old_cmcb -> prev != NULL)
+			old_cmcb -> prev -> next = old_cmcb -> next;
 		else
-			free_head = old_cmcb -> next;
+		{
+			int bin = bin_of(old_cmcb -> size);
+			bins[bin] = old_cmcb -> next;
+			if(bins[bin] == NULL)
+				bin_bitmap &= ~(1u << bin);
+		}
 	}
-	
 
 	old_cmcb -> type = NULL;
 	old_cmcb -> next = NULL;
 	old_cmcb -> prev = NULL;
 
 	return old_cmcb;
-}
\ No newline at end of file
+}
@@ -1,13 +1,26 @@
 #include <system.h>
 
+#define BIN_STEP 8 ///< requests are rounded up to a multiple of this, and exact-fit bins are this far apart
+#define EXACT_BINS 16 ///< bins 0-15 each hold one size class of BIN_STEP bytes: sizes up to 127
+#define DEFAULT_HEAP_LIMIT 0x400000 ///< the most the heap may grow to, in bytes, unless set otherwise (see set_heap_limit())
+#define BIN_COUNT 32 ///< bins 16-31 hold sizes from 2^7 up, one power of two each; the last holds the rest
+#define SHOW_OWNED_MAX 32 ///< the most blocks show_owned_mem() lists
+#define LARGE_ALLOC 4096 ///< requests of this many bytes or more get whole pages (see page_alloc()) instead of a block of the heap
+
 enum memory_type {Allocated, Free};
 
+#define CMCB_ALLOCATED 0x414C4C43 ///< magic value of the CMCB of an allocated block ("ALLC")
+#define CMCB_FREE 0x46524545 ///< magic value of the CMCB of a free block ("FREE")
+#define CMCB_PAGES 0x50414745 ///< magic value of the CMCB of a block of whole pages, which is kept outside the block and has no LMCB ("PAGE")
+
 typedef struct CMCB{
+	u32int magic; /// CMCB_ALLOCATED or CMCB_FREE, so free_mem() can tell a real CMCB from a bad pointer
 	enum memory_type type;
 	u32int address;
 	u32int size;
-	char proc_name[21];
-	struct CMCB* next;
+	struct PCB* owner; /// process that allocated the block, or NULL if it belongs to no process (see set_mem_owner())
+	char proc_name[21]; /// name of the owner when the block was allocated, "" if it has none
+	struct CMCB* next; /// next block in the same free bin, or in the owner's list if allocated
 	struct CMCB* prev;
 } CMCB;
 
@@ -16,10 +29,43 @@ typedef struct LMCB{
 	u32int size;
 } LMCB;
 
-void init_heap(u32int size);
+/**
+ * Statistics of the heap, kept up to date as blocks are allocated and freed (see get_heap_stats())
+*/
+typedef struct heap_stats{
+	u32int total_bytes; /// size of the heap, including every CMCB and LMCB
+	u32int limit_bytes; /// the most total_bytes may grow to
+	u32int grows; /// times the heap has mapped more pages to satisfy an allocation
+	u32int used_bytes; /// bytes in allocated blocks, not counting their CMCBs and LMCBs
+	u32int free_bytes; /// bytes in free blocks, not counting their CMCBs and LMCBs
+	u32int peak_used_bytes; /// the most used_bytes has ever been
+	u32int allocated_blocks;
+	u32int free_blocks;
+	u32int largest_free; /// size of the largest free block, the largest allocation that can succeed; found by walking one bin (see get_heap_stats())
+	u32int allocs; /// successful calls to allocate_mem()
+	u32int failed_allocs; /// calls to allocate_mem() with no block large enough
+	u32int frees; /// successful calls to free_mem()
+	u32int reallocs; /// calls to reallocate_mem() on an allocated block
+	u32int reallocs_in_place; /// those that resized the block without moving it
+	u32int page_blocks; /// allocations of LARGE_ALLOC or more, which are blocks of whole pages outside the heap
+	u32int page_bytes; /// bytes mapped for them
+	u32int region_free_pages; /// pages of the page region not in any block (see get_page_region_stats())
+	u32int region_largest_free; /// pages in the largest free block of the page region
+	u32int reclaimed_blocks; /// blocks freed because the process that owned them ended (see free_owned_mem())
+	u32int reclaimed_bytes;
+} heap_stats;
+
+void init_heap(u32int size, u32int limit);
+u32int set_heap_limit(u32int limit);
 u32int allocate_mem(u32int bytes);
 int free_mem(void* ipaddr);
+u32int reallocate_mem(void* ipaddr, u32int bytes);
+int set_mem_owner(void* ipaddr, struct PCB* owner);
+u32int free_owned_mem(struct PCB* owner);
+void show_owned_mem(char* name);
 void show_cmcbs(enum memory_type the_type);
+void get_heap_stats(heap_stats* stats);
+void show_heap_stats();
 int is_empty();
 void add_cmcb(CMCB* new_cmcb, enum memory_type new_type);
 CMCB* remove_cmcb(CMCB* old_cmcb);
\ No newline at end of file
@@ -0,0 +1,578 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <string.h>
+
+#include "../TestR5.h"
+#include "host.h"
+
+/**
+ * r5bench runs the R5 heap (modules/R5/TestR5.c) as a Linux program, so a change to how it
+ * allocates can be measured in seconds instead of by booting MPX. It replays a trace of heap
+ * operations, either read from a file or made up from one of the synthetic workloads, and
+ * reports operations per second, the latency of each kind of operation, how large the heap
+ * grew, and how fragmented it was as the trace went on.
+ *
+ * A trace is a text file with one operation per line; lines starting with # are ignored:
+ *	a <id> <bytes>	allocate a block of <bytes> and call it <id>
+ *	r <id> <bytes>	resize block <id> to <bytes> (allocates it if <id> isn't live)
+ *	f <id>		free block <id>
+ * Ids name blocks while they are live, and can be reused once they are freed.
+ *
+ * The trace is replayed twice: once untimed for throughput, and once timing every operation
+ * (which slows it down) for latencies and the fragmentation timeline. With -c it is replayed
+ * a third time, filling every block and checking its contents before it is resized or freed.
+*/
+
+#define DEFAULT_OPS 200000 ///< operations in a synthetic trace, unless -n is given
+#define DEFAULT_LIVE 1000 ///< ids a synthetic trace uses, unless -k is given
+#define DEFAULT_HEAP 50000 ///< initial heap size, the same as kmain gives it
+#define TIMELINE_ROWS 20 ///< rows of the fragmentation timeline, unless -i is given
+
+enum op_kind {OpAlloc, OpRealloc, OpFree, OP_KINDS};
+
+static const char kind_letters[OP_KINDS] = {'a', 'r', 'f'};
+static const char* kind_names[OP_KINDS] = {"allocate", "reallocate", "free"};
+
+/**
+ * One operation of a trace.
+*/
+typedef struct Op {
+	enum op_kind kind;
+	u32int id; /// the block it operates on
+	u32int bytes; /// size to allocate or resize to, unused for OpFree
+} Op;
+
+/**
+ * A trace of operations, in the order they are replayed.
+*/
+typedef struct Trace {
+	Op* ops;
+	u32int count;
+	u32int capacity;
+	u32int ids; /// one more than the largest id in the trace
+} Trace;
+
+/**
+ * What a replay found.
+*/
+typedef struct Results {
+	u64int elapsed_ns; /// time the whole replay took
+	u32int failed[OP_KINDS]; /// operations the heap refused
+	u32int skipped; /// operations that didn't make sense, like freeing an id that isn't live
+	u32int corrupted; /// blocks whose contents changed while they were allocated (with -c)
+	u32int* latencies[OP_KINDS]; /// nanoseconds each operation took, when they are timed
+	u32int timed[OP_KINDS]; /// entries in latencies
+} Results;
+
+enum replay_flags {TimeEach = 1, Timeline = 2, Check = 4};
+
+static u32int heap_size = DEFAULT_HEAP;
+static u32int heap_limit = DEFAULT_HEAP_LIMIT;
+static u32int timer_overhead; /// nanoseconds it takes to read the clock twice
+
+static unsigned int random_state = 1;
+
+/**
+ * This function returns the next number of a xorshift sequence, so a synthetic trace is the
+ * same for a given seed whatever C library it is built with.
+ *
+ * @return a pseudo-random number
+*/
+static unsigned int next_random()
+{
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
+	return random_state;
+}
+
+/**
+ * This function picks a block size for a synthetic trace: mostly small blocks like PCB tables
+ * and strings, some up to a page, and a few large ones.
+ *
+ * @return the size in bytes
+*/
+static u32int random_size()
+{
+	unsigned int kind = next_random() % 100;
+	if (kind < 70)
+		return 1 + next_random() % 128;
+	if (kind < 95)
+		return 129 + next_random() % (4096 - 128);
+	return 4097 + next_random() % (32768 - 4096);
+}
+
+/**
+ * This function returns the time of a monotonic clock.
+ *
+ * @return the time in nanoseconds
+*/
+static u64int now_ns()
+{
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (u64int)time.tv_sec * 1000000000ull + time.tv_nsec;
+}
+
+/**
+ * This function adds an operation to the end of a trace.
+ *
+ * @param trace - the trace
+ * @param kind - what the operation does
+ * @param id - the block it operates on
+ * @param bytes - the size it allocates or resizes to
+*/
+static void add_op(Trace* trace, enum op_kind kind, u32int id, u32int bytes)
+{
+	if ((*trace).count == (*trace).capacity) {
+		(*trace).capacity = (*trace).capacity ? 2 * (*trace).capacity : 1024;
+		(*trace).ops = realloc((*trace).ops, (*trace).capacity * sizeof(Op));
+		if ((*trace).ops == NULL) {
+			fprintf(stderr, "r5bench: out of memory for the trace\n");
+			exit(1);
+		}
+	}
+
+	Op* op = &(*trace).ops[(*trace).count++];
+	(*op).kind = kind;
+	(*op).id = id;
+	(*op).bytes = bytes;
+	if (id >= (*trace).ids)
+		(*trace).ids = id + 1;
+}
+
+/**
+ * This function reads a trace from a file (see the top of this file for the format).
+ *
+ * @param path - the file to read
+ * @param trace - where to put the operations
+*/
+static void load_trace(char* path, Trace* trace)
+{
+	FILE* file = fopen(path, "r");
+	if (file == NULL) {
+		perror(path);
+		exit(1);
+	}
+
+	char line[256];
+	u32int line_number = 0;
+	while (fgets(line, sizeof(line), file) != NULL) {
+		line_number++;
+
+		char letter;
+		unsigned long id;
+		unsigned long bytes = 0;
+		int fields = sscanf(line, " %c %lu %lu", &letter, &id, &bytes);
+		if (fields <= 0 || letter == '#')
+			continue;
+
+		enum op_kind kind;
+		for (kind = 0; kind < OP_KINDS; kind++)
+			if (kind_letters[kind] == letter)
+				break;
+		if (kind == OP_KINDS || fields < (kind == OpFree ? 2 : 3)) {
+			fprintf(stderr, "%s:%lu: expected \"a <id> <bytes>\", \"r <id> <bytes>\" or \"f <id>\"\n",
+				path, line_number);
+			exit(1);
+		}
+		add_op(trace, kind, id, bytes);
+	}
+	fclose(file);
+}
+
+/**
+ * This function makes up a trace. The "random" workload allocates, resizes and frees blocks at
+ * random, so the heap settles with about half the ids live. The "ramp" workload allocates every
+ * id and then frees them all in random order, over and over, which splits the heap up and then
+ * has to merge it back together.
+ *
+ * @param workload - "random" or "ramp"
+ * @param ops - how many operations to make
+ * @param ids - how many ids to use
+ * @param trace - where to put the operations
+*/
+static void generate_trace(char* workload, u32int ops, u32int ids, Trace* trace)
+{
+	u8int* live = calloc(ids, 1);
+	u32int* order = calloc(ids, sizeof(u32int));
+	if (live == NULL || order == NULL) {
+		fprintf(stderr, "r5bench: out of memory for the trace\n");
+		exit(1);
+	}
+
+	if (strcmp(workload, "random") == 0) {
+		while ((*trace).count < ops) {
+			u32int id = next_random() % ids;
+			if (!live[id])
+				add_op(trace, OpAlloc, id, random_size());
+			else if (next_random() % 8 == 0)
+				add_op(trace, OpRealloc, id, random_size());
+			else
+				add_op(trace, OpFree, id, 0);
+			live[id] = (*trace).ops[(*trace).count - 1].kind != OpFree;
+		}
+	}
+	else if (strcmp(workload, "ramp") == 0) {
+		while ((*trace).count < ops) {
+			u32int allocated;
+			for (allocated = 0; allocated < ids && (*trace).count < ops; allocated++) {
+				add_op(trace, OpAlloc, allocated, random_size());
+				order[allocated] = allocated;
+			}
+			// free them in a random order (Fisher-Yates)
+			u32int i;
+			for (i = allocated; i > 1; i--) {
+				u32int j = next_random() % i;
+				u32int swap = order[i - 1];
+				order[i - 1] = order[j];
+				order[j] = swap;
+			}
+			for (i = 0; i < allocated && (*trace).count < ops; i++)
+				add_op(trace, OpFree, order[i], 0);
+		}
+	}
+	else {
+		fprintf(stderr, "r5bench: unknown workload \"%s\" (try random or ramp)\n", workload);
+		exit(1);
+	}
+
+	free(live);
+	free(order);
+}
+
+/**
+ * This function writes a trace to a file, so it can be replayed later with -t.
+ *
+ * @param path - the file to write
+ * @param trace - the trace
+*/
+static void write_trace(char* path, Trace* trace)
+{
+	FILE* file = fopen(path, "w");
+	if (file == NULL) {
+		perror(path);
+		exit(1);
+	}
+
+	u32int i;
+	for (i = 0; i < (*trace).count; i++) {
+		Op* op = &(*trace).ops[i];
+		if ((*op).kind == OpFree)
+			fprintf(file, "f %lu\n", (*op).id);
+		else
+			fprintf(file, "%c %lu %lu\n", kind_letters[(*op).kind], (*op).id, (*op).bytes);
+	}
+	fclose(file);
+}
+
+/**
+ * This function fills a block with a pattern that depends on its id, for -c.
+ *
+ * @param address - the block
+ * @param bytes - how much of it to fill
+ * @param id - its id
+*/
+static void fill_block(u32int address, u32int bytes, u32int id)
+{
+	u8int* block = (u8int*)address;
+	u32int i;
+	for (i = 0; i < bytes; i++)
+		block[i] = (u8int)(id * 31 + i);
+}
+
+/**
+ * This function checks that a block still holds the pattern fill_block() left in it.
+ *
+ * @param address - the block
+ * @param bytes - how much of it to check
+ * @param id - its id
+ * @return 1 if it does, 0 if it has been overwritten
+*/
+static int check_block(u32int address, u32int bytes, u32int id)
+{
+	u8int* block = (u8int*)address;
+	u32int i;
+	for (i = 0; i < bytes; i++)
+		if (block[i] != (u8int)(id * 31 + i))
+			return 0;
+	return 1;
+}
+
+/**
+ * This function prints the header of the fragmentation timeline.
+*/
+static void print_timeline_header()
+{
+	printf("\n%10s %10s %10s %10s %10s %6s\n", "OPS", "HEAP", "USED", "FREE", "LARGEST", "FRAG%");
+}
+
+/**
+ * This function prints a row of the fragmentation timeline: the heap as it is after some number
+ * of operations. Fragmentation is worked out as in show_heap_stats().
+ *
+ * @param ops - operations replayed so far
+*/
+static void print_timeline_row(u32int ops)
+{
+	heap_stats stats;
+	get_heap_stats(&stats);
+
+	double fragmentation = 0;
+	if (stats.free_bytes != 0)
+		fragmentation = 100.0 * (stats.free_bytes - stats.largest_free) / stats.free_bytes;
+	printf("%10lu %10lu %10lu %10lu %10lu %6.1f\n", ops, stats.total_bytes, stats.used_bytes,
+		stats.free_bytes, stats.largest_free, fragmentation);
+}
+
+/**
+ * This function replays a trace on a new heap.
+ *
+ * @param trace - the trace
+ * @param flags - TimeEach to time every operation, Timeline to print the fragmentation
+ * timeline every interval operations, Check to fill and check the blocks
+ * @param interval - operations between rows of the timeline
+ * @param results - where to put what was found
+*/
+static void replay(Trace* trace, int flags, u32int interval, Results* results)
+{
+	u32int* addresses = calloc((*trace).ids, sizeof(u32int));
+	u32int* sizes = calloc((*trace).ids, sizeof(u32int));
+	if (addresses == NULL || sizes == NULL) {
+		fprintf(stderr, "r5bench: out of memory for the replay\n");
+		exit(1);
+	}
+
+	host_reset();
+	host_quiet = 1; // the heap prints every failed allocation
+	init_heap(heap_size, heap_limit);
+
+	if (flags & Timeline)
+		print_timeline_header();
+
+	u64int start = now_ns();
+	u32int i;
+	for (i = 0; i < (*trace).count; i++) {
+		Op* op = &(*trace).ops[i];
+		u32int id = (*op).id;
+		u32int address = addresses[id];
+		u64int before = 0;
+
+		if ((*op).kind == OpAlloc && address != NULL) {
+			(*results).skipped++;
+			continue;
+		}
+		if ((*op).kind == OpFree && address == NULL) {
+			(*results).skipped++;
+			continue;
+		}
+		if ((flags & Check) && address != NULL && (*op).kind != OpAlloc) {
+			u32int kept = sizes[id];
+			if ((*op).kind == OpRealloc && (*op).bytes < kept)
+				kept = (*op).bytes;
+			if (!check_block(address, kept, id))
+				(*results).corrupted++;
+		}
+
+		if (flags & TimeEach)
+			before = now_ns();
+		switch ((*op).kind) {
+		case OpAlloc:
+			address = allocate_mem((*op).bytes);
+			break;
+		case OpRealloc:
+			address = reallocate_mem((void*)address, (*op).bytes);
+			break;
+		default:
+			free_mem((void*)address);
+			address = NULL;
+			break;
+		}
+		if (flags & TimeEach) {
+			u64int took = now_ns() - before;
+			took = took > timer_overhead ? took - timer_overhead : 0;
+			(*results).latencies[(*op).kind][(*results).timed[(*op).kind]++] = (u32int)took;
+		}
+
+		if ((*op).kind != OpFree && address == NULL) {
+			(*results).failed[(*op).kind]++; // a failed resize leaves the block as it was
+		}
+		else {
+			if ((flags & Check) && (*op).kind != OpFree)
+				fill_block(address, (*op).bytes, id);
+			addresses[id] = address;
+			sizes[id] = (*op).bytes;
+		}
+
+		if ((flags & Timeline) && (i + 1) % interval == 0)
+			print_timeline_row(i + 1);
+	}
+	(*results).elapsed_ns = now_ns() - start;
+
+	if ((flags & Timeline) && (*trace).count % interval != 0)
+		print_timeline_row((*trace).count);
+
+	host_quiet = 0;
+	free(addresses);
+	free(sizes);
+}
+
+static int compare_latencies(const void* a, const void* b)
+{
+	u32int x = *(const u32int*)a;
+	u32int y = *(const u32int*)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * This function prints the latency percentiles of each kind of operation.
+ *
+ * @param results - the results of a replay that timed every operation
+*/
+static void print_latencies(Results* results)
+{
+	printf("\n%-11s %10s %8s %8s %8s %8s %8s %8s\n", "LATENCY ns", "COUNT", "MEAN", "P50", "P90",
+		"P99", "P99.9", "MAX");
+
+	enum op_kind kind;
+	for (kind = 0; kind < OP_KINDS; kind++) {
+		u32int count = (*results).timed[kind];
+		u32int* latencies = (*results).latencies[kind];
+		if (count == 0)
+			continue;
+
+		qsort(latencies, count, sizeof(u32int), compare_latencies);
+		u64int total = 0;
+		u32int i;
+		for (i = 0; i < count; i++)
+			total += latencies[i];
+
+		printf("%-11s %10lu %8llu %8lu %8lu %8lu %8lu %8lu\n", kind_names[kind], count,
+			total / count, latencies[count / 2], latencies[(u64int)count * 90 / 100],
+			latencies[(u64int)count * 99 / 100], latencies[(u64int)count * 999 / 1000],
+			latencies[count - 1]);
+	}
+}
+
+/**
+ * This function measures how long reading the clock twice takes, which is taken off every
+ * latency.
+*/
+static void measure_timer_overhead()
+{
+	int i;
+	timer_overhead = ~0u;
+	for (i = 0; i < 1000; i++) {
+		u64int before = now_ns();
+		u64int took = now_ns() - before;
+		if (took < timer_overhead)
+			timer_overhead = took;
+	}
+}
+
+static void usage()
+{
+	fprintf(stderr,
+		"usage: r5bench [-t trace | -w random|ramp] [options]\n"
+		"  -t file     replay the trace in file\n"
+		"  -w name     replay a synthetic workload: random (default) or ramp\n"
+		"  -n ops      operations in a synthetic trace (default %d)\n"
+		"  -k ids      blocks a synthetic trace uses (default %d)\n"
+		"  -s seed     seed of a synthetic trace (default 1)\n"
+		"  -g file     also write the trace to file, to replay later with -t\n"
+		"  -H bytes    initial heap size (default %d)\n"
+		"  -L bytes    most the heap may grow to (default %d)\n"
+		"  -i ops      operations between rows of the fragmentation timeline\n"
+		"  -c          also replay filling every block and checking it is left alone\n",
+		DEFAULT_OPS, DEFAULT_LIVE, DEFAULT_HEAP, DEFAULT_HEAP_LIMIT);
+	exit(2);
+}
+
+int main(int argc, char** argv)
+{
+	char* trace_path = NULL;
+	char* workload = "random";
+	char* output_path = NULL;
+	u32int ops = DEFAULT_OPS;
+	u32int ids = DEFAULT_LIVE;
+	u32int interval = 0;
+	int check = 0;
+
+	int option;
+	while ((option = getopt(argc, argv, "t:w:n:k:s:g:H:L:i:c")) != -1) {
+		switch (option) {
+		case 't': trace_path = optarg; break;
+		case 'w': workload = optarg; break;
+		case 'n': ops = strtoul(optarg, NULL, 0); break;
+		case 'k': ids = strtoul(optarg, NULL, 0); break;
+		case 's': random_state = strtoul(optarg, NULL, 0); break;
+		case 'g': output_path = optarg; break;
+		case 'H': heap_size = strtoul(optarg, NULL, 0); break;
+		case 'L': heap_limit = strtoul(optarg, NULL, 0); break;
+		case 'i': interval = strtoul(optarg, NULL, 0); break;
+		case 'c': check = 1; break;
+		default: usage();
+		}
+	}
+	if (optind != argc || ids == 0 || random_state == 0)
+		usage();
+
+	Trace trace = {NULL, 0, 0, 0};
+	if (trace_path != NULL)
+		load_trace(trace_path, &trace);
+	else
+		generate_trace(workload, ops, ids, &trace);
+	if (output_path != NULL)
+		write_trace(output_path, &trace);
+	if (trace.count == 0) {
+		fprintf(stderr, "r5bench: the trace is empty\n");
+		return 1;
+	}
+	if (interval == 0)
+		interval = (trace.count + TIMELINE_ROWS - 1) / TIMELINE_ROWS;
+
+	host_init();
+	measure_timer_overhead();
+	printf("Replaying %lu operations on %lu ids (%s), heap %lu bytes growing to at most %lu\n",
+		trace.count, trace.ids, trace_path != NULL ? trace_path : workload, heap_size, heap_limit);
+
+	Results throughput = {0};
+	replay(&trace, 0, interval, &throughput);
+	printf("\nThroughput: %.0f operations per second (%.3f ms in all)\n",
+		trace.count * 1e9 / (throughput.elapsed_ns ? throughput.elapsed_ns : 1),
+		throughput.elapsed_ns / 1e6);
+	printf("Failed: %lu allocations, %lu reallocations; skipped %lu operations that don't make sense\n",
+		throughput.failed[OpAlloc], throughput.failed[OpRealloc], throughput.skipped);
+
+	Results timed = {0};
+	enum op_kind kind;
+	for (kind = 0; kind < OP_KINDS; kind++) {
+		timed.latencies[kind] = malloc(trace.count * sizeof(u32int));
+		if (timed.latencies[kind] == NULL) {
+			fprintf(stderr, "r5bench: out of memory for the latencies\n");
+			return 1;
+		}
+	}
+	replay(&trace, TimeEach | Timeline, interval, &timed);
+	print_latencies(&timed);
+
+	heap_stats stats;
+	get_heap_stats(&stats);
+	printf("\nFootprint: heap grew to %lu bytes, at most %lu pages were mapped at once (heap and page blocks),\n"
+		"at most %lu bytes of the heap were in use at once\n",
+		stats.total_bytes, host_peak_frames, stats.peak_used_bytes);
+
+	// the same summary "mem stats" prints in MPX, for the timed replay
+	show_heap_stats();
+
+	if (check) {
+		Results checked = {0};
+		replay(&trace, Check, interval, &checked);
+		printf("\nCheck: %lu blocks changed while they were allocated\n", checked.corrupted);
+		if (checked.corrupted != 0)
+			return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "host.h"
+#include <mem/heap.h>
+#include <mem/paging.h>
+#include <mem/buddy.h>
+#include "../../R2/PCBTable.h"
+
+/**
+ * The kernel functions the R5 heap calls, done with the C library, so TestR5.c builds as a Linux
+ * program without changes. The heap region and the page region are mapped all at once by
+ * host_init(), so the page entries get_page() hands out only record which pages the kernel
+ * would have mapped, for counting frames.
+*/
+
+int host_quiet = 0;
+u32int host_messages = 0;
+u32int host_frames = 0;
+u32int host_peak_frames = 0;
+
+page_dir *kdir = NULL; // never looked at, since get_page() ignores the directory
+static page_entry heap_pages[MPX_HEAP_SIZE / PAGE_SIZE];
+static page_entry region_pages[PAGE_REGION_PAGES];
+
+/**
+ * This function maps a region into the program at the same address it has in the kernel. It
+ * exits if anything is already mapped there.
+ *
+ * @param base - the address of the region
+ * @param size - its size in bytes
+*/
+static void map_region(u32int base, u32int size)
+{
+	void* region = mmap((void*)base, size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+	if (region != (void*)base) {
+		fprintf(stderr, "r5bench: can't map a region at %#lx\n", base);
+		exit(1);
+	}
+}
+
+/**
+ * This function maps the MPX heap region (see MPX_HEAP_BASE) and the page region that large
+ * blocks come from (see PAGE_REGION_BASE) into the program.
+*/
+void host_init()
+{
+	map_region(MPX_HEAP_BASE, MPX_HEAP_SIZE);
+	map_region(PAGE_REGION_BASE, PAGE_REGION_SIZE);
+}
+
+/**
+ * This function zeroes the counters and frees the whole page region, before the heap is set up
+ * again with init_heap().
+*/
+void host_reset()
+{
+	host_messages = 0;
+	host_frames = 0;
+	host_peak_frames = 0;
+	memset(heap_pages, 0, sizeof(heap_pages));
+	memset(region_pages, 0, sizeof(region_pages));
+	init_buddy();
+}
+
+page_entry* get_page(u32int addr, page_dir *dir, int make_table)
+{
+	(void)dir;
+	(void)make_table;
+	if (addr >= MPX_HEAP_BASE && addr < MPX_HEAP_BASE + MPX_HEAP_SIZE)
+		return &heap_pages[(addr - MPX_HEAP_BASE) / PAGE_SIZE];
+	if (addr >= PAGE_REGION_BASE && addr < PAGE_REGION_BASE + PAGE_REGION_SIZE)
+		return &region_pages[(addr - PAGE_REGION_BASE) / PAGE_SIZE];
+	return NULL;
+}
+
+void new_frame(page_entry* page)
+{
+	if (page->present)
+		return;
+	page->present = 1;
+	if (++host_frames > host_peak_frames)
+		host_peak_frames = host_frames;
+}
+
+void free_frame(u32int addr, page_dir *dir)
+{
+	page_entry* page = get_page(addr, dir, 0);
+	if (!page || !page->present)
+		return;
+	page->present = 0;
+	host_frames--;
+}
+
+/**
+ * No process is ever running, so every block belongs to no process.
+*/
+struct PCB* get_running_pcb()
+{
+	return NULL;
+}
+
+PCB* lookup_pcb(char* name)
+{
+	(void)name;
+	return NULL;
+}
+
+void print(char* buffer)
+{
+	if (!host_quiet)
+		fputs(buffer, stdout);
+}
+
+void println(char* buffer)
+{
+	host_messages++;
+	if (!host_quiet)
+		puts(buffer);
+}
+
+void print_int(int value)
+{
+	if (!host_quiet)
+		printf("%d", value);
+}
+
+void bad_itoa(char string[12], int num)
+{
+	snprintf(string, 12, "%d", num);
+}
+
+void klogv(const char *msg)
+{
+	host_messages++;
+	if (!host_quiet)
+		fprintf(stderr, "%s\n", msg);
+}
+
+void kpanic(const char *msg)
+{
+	fprintf(stderr, "r5bench: %s\n", msg);
+	exit(1);
+}
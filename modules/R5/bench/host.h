@@ -0,0 +1,14 @@
+#ifndef HostCompile
+#define HostCompile
+
+#include <system.h>
+
+extern int host_quiet; ///< when set, what the heap prints is counted instead of shown
+extern u32int host_messages; ///< lines the heap printed (or would have) since host_reset()
+extern u32int host_frames; ///< frames mapped now, for the heap and for blocks of whole pages
+extern u32int host_peak_frames; ///< the most frames that have been mapped at once since host_reset()
+
+void host_init();
+void host_reset();
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef _TSC_H
+#define _TSC_H
+
+#include <system.h>
+
+/*
+  Stand-in for include/core/tsc.h when the R5 heap is built as a
+  Linux program (see ../../Makefile). The C library can do 64 bit
+  division, so div64 is just that.
+*/
+
+static inline u64int rdtsc()
+{
+  return __builtin_ia32_rdtsc();
+}
+
+static inline u64int div64(u64int n, u32int d)
+{
+  return n / d;
+}
+
+#endif
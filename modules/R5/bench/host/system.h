@@ -0,0 +1,62 @@
+#ifndef _SYSTEM_H
+#define _SYSTEM_H
+
+/*
+  Stand-in for include/system.h when the R5 heap is built as a
+  Linux program (see ../Makefile). It has the same types, but
+  interrupts are left alone: the benchmark is single threaded,
+  so there is nothing for irq_save to keep out.
+*/
+
+#include <stddef.h>
+
+#undef NULL
+#define NULL 0
+
+// Suppress 'unused parameter' warnings/errors
+#define no_warn(p) if (p) while (1) break
+
+/* System Types */
+/* the same as the kernel's, and the benchmark is built 32-bit (-m32)
+   so that they are the same size: the heap keeps addresses in u32int
+   fields, and the size of its CMCBs and LMCBs decides its overhead,
+   where blocks are split and which bin they go in */
+typedef unsigned char  u8int;
+typedef unsigned short u16int;
+typedef unsigned long  u32int;
+typedef unsigned long long u64int;
+
+_Static_assert(sizeof(u32int) == 4 && sizeof(void*) == 4,
+  "r5bench must be built 32-bit (gcc -m32) to measure the kernel's heap layout");
+
+/* Time */
+typedef struct {
+  int sec;
+  int min;
+  int hour;
+  int day_w;
+  int day_m;
+  int day_y;
+  int mon;
+  int year;
+} date_time;
+
+static inline int irq_on()
+{
+  return 0;
+}
+
+static inline int irq_save()
+{
+  return 0;
+}
+
+static inline void irq_restore(int f)
+{
+  (void)f;
+}
+
+void klogv(const char *msg);
+void kpanic(const char *msg);
+
+#endif
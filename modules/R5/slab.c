@@ -0,0 +1,135 @@
+#include "slab.h"
+#include "TestR5.h"
+#include "../R1/r1functions.h"
+#include "../mpx_supt.h"
+#include <string.h>
+
+static Cache* caches = NULL; /// every cache that has taken a slab, for show_caches()
+
+/**
+ * This function returns the free list link of an object, which is kept in the word after the
+ * object so that a free object keeps the state its constructor left it in.
+ * 
+ * @param cache - the cache the object belongs to
+ * @param object - the object
+ * @return a pointer to the object's link
+*/
+static void** link_of(Cache* cache, void* object) {
+	return (void**)((u8int*)object + (*cache).slot_size - sizeof(void*));
+}
+
+/**
+ * This function takes a new slab from the heap and puts all of its objects on the free list,
+ * constructing each one. The first slab also works out the cache's layout and registers it.
+ * 
+ * @param cache - the cache to grow
+ * @return 1 if the cache grew, 0 if the heap is out of memory
+*/
+static int grow_cache(Cache* cache) {
+	if ((*cache).slot_size == 0) {
+		(*cache).slot_size = (((*cache).object_size + 3) & ~3) + sizeof(void*);
+		(*cache).per_slab = SLAB_BYTES / (*cache).slot_size;
+		if ((*cache).per_slab < SLAB_MIN_OBJECTS)
+			(*cache).per_slab = SLAB_MIN_OBJECTS;
+		(*cache).next = caches;
+		caches = cache;
+	}
+
+	// the first word of the slab links the cache's slabs together
+	u8int* slab = sys_alloc_mem(sizeof(void*) + (*cache).per_slab * (*cache).slot_size);
+	if (slab == NULL)
+		return 0;
+	set_mem_owner(slab, NULL); // the cache outlives whichever process made it grow
+	*(void**)slab = (*cache).slabs;
+	(*cache).slabs = slab;
+	(*cache).slab_count++;
+
+	u32int i;
+	u8int* object = slab + sizeof(void*);
+	for (i = 0; i < (*cache).per_slab; i++, object += (*cache).slot_size) {
+		if ((*cache).ctor != NULL)
+			(*cache).ctor(object);
+		*link_of(cache, object) = (*cache).free_list;
+		(*cache).free_list = object;
+	}
+	return 1;
+}
+
+/**
+ * This function allocates an object from a cache. It takes constant time unless the cache is
+ * empty and has to grow by a slab. If the cache has a constructor, the object is in the state
+ * the constructor (or the last user to free it) left it in; otherwise its contents are undefined.
+ * 
+ * @param cache - the cache to allocate from
+ * @return the object, or NULL if the heap is out of memory
+*/
+void* cache_alloc(Cache* cache) {
+	int irqs = irq_save();
+
+	if ((*cache).free_list == NULL) {
+		(*cache).grows++;
+		if (!grow_cache(cache)) {
+			irq_restore(irqs);
+			return NULL;
+		}
+	}
+
+	void* object = (*cache).free_list;
+	(*cache).free_list = *link_of(cache, object);
+	(*cache).in_use++;
+	(*cache).allocs++;
+
+	irq_restore(irqs);
+	return object;
+}
+
+/**
+ * This function returns an object to the cache it was allocated from. Objects of a cache with a
+ * constructor must be returned in their constructed state.
+ * 
+ * @param cache - the cache the object came from
+ * @param object - the object to free (NULL is ignored)
+*/
+void cache_free(Cache* cache, void* object) {
+	if (object == NULL)
+		return;
+
+	int irqs = irq_save();
+	*link_of(cache, object) = (*cache).free_list;
+	(*cache).free_list = object;
+	(*cache).in_use--;
+	(*cache).frees++;
+	irq_restore(irqs);
+}
+
+/**
+ * This function prints the statistics of every cache that has been used: object size, slabs
+ * taken from the heap, objects in use out of those carved, and allocation counts.
+*/
+void show_caches() {
+	println("");
+	print_column("CACHE", 12);
+	print_column("SIZE", 6);
+	print_column("SLABS", 7);
+	print_column("IN USE", 8);
+	print_column("TOTAL", 7);
+	print_column("ALLOCS", 9);
+	print_column("FREES", 9);
+	println("GROWS");
+
+	int irqs = irq_save(); // caches are only ever added at the head, so a snapshot of the
+	Cache* cache = caches; // head is enough to walk them safely
+	irq_restore(irqs);
+
+	for (; cache != NULL; cache = (*cache).next) {
+		print_column((*cache).name, 12);
+		print_int_column((*cache).object_size, 6);
+		print_int_column((*cache).slab_count, 7);
+		print_int_column((*cache).in_use, 8);
+		print_int_column((*cache).slab_count * (*cache).per_slab, 7);
+		print_int_column((*cache).allocs, 9);
+		print_int_column((*cache).frees, 9);
+		print_int_column((*cache).grows, 0);
+		println("");
+	}
+}
@@ -0,0 +1,40 @@
+#ifndef SlabCompile
+#define SlabCompile
+
+#include <system.h>
+
+#define SLAB_BYTES 1024 ///< target size of one slab; small objects get more per slab
+#define SLAB_MIN_OBJECTS 8 ///< fewest objects carved from one slab, however big they are
+
+/**
+ * A cache of fixed-size kernel objects. Objects are carved out of slabs (blocks taken from the
+ * heap a few objects at a time) and a freed object goes onto the cache's free list to be handed
+ * straight back out by the next allocation, so the heap is only visited when a cache grows.
+ * Define one per object type with CACHE_INIT; it needs no other setup.
+*/
+typedef struct Cache {
+	char* name; /// name shown by show_caches()
+	u32int object_size; /// size of the objects, as requested
+	void (*ctor)(void*); /// called once on each object when its slab is carved, or NULL
+	u32int slot_size; /// object_size rounded up, plus the free list link
+	u32int per_slab; /// objects carved from each slab
+	void* free_list; /// free objects, linked through the word after each object
+	void* slabs; /// slabs taken from the heap, linked through their first word
+	u32int slab_count; /// number of slabs taken from the heap
+	u32int in_use; /// objects currently allocated
+	u32int allocs; /// total cache_alloc() calls that succeeded
+	u32int frees; /// total cache_free() calls
+	u32int grows; /// allocations that had to take a new slab from the heap
+	struct Cache* next; /// next cache in the list show_caches() walks
+} Cache;
+
+/**
+ * Static initializer for a cache of objects of the given type
+*/
+#define CACHE_INIT(name, type, ctor) { name, sizeof(type), ctor, 0, 0, NULL, NULL, 0, 0, 0, 0, 0, NULL }
+
+void* cache_alloc(Cache* cache);
+void cache_free(Cache* cache, void* object);
+void show_caches();
+
+#endif
@@ -1,5 +1,9 @@
 #include "IOCB.h"
 #include <core/serial.h>
+#include <core/timer.h>
+#include "../R5/slab.h"
+
+static Cache request_cache = CACHE_INIT("iorequest", IORequest, NULL); /// where IO requests are allocated from
 
 /**
  * This functions creates a request "block" by making an IO request node. 
@@ -12,7 +16,9 @@
 */
 IORequest* make_request(int op_code, int device_id, char *buffer_ptr, int *count_ptr, PCB* currPCB) {
 
-	IORequest* request = sys_alloc_mem(sizeof(IORequest));
+	IORequest* request = cache_alloc(&request_cache);
+	if (request == NULL)
+		kpanic("Out of memory for IO requests");
 	request -> op_code = op_code;
 	request -> device_id = device_id;
 	request -> buffer_ptr = buffer_ptr;
@@ -23,45 +29,88 @@ IORequest* make_request(int op_code, int device_id, char *buffer_ptr, int *count
 }
 
 /**
- * This functions adds an IO request to the queue(FIFO). 
+ * This function frees an IO request once its details have been copied into the IOCB.
+ * @param request the request to free
+*/
+void free_request(IORequest* request) {
+	cache_free(&request_cache, request);
+}
+
+/**
+ * This functions adds an IO request to the back of the queue, noting when it started waiting.
  * @param queue pointer to an IOQueue to be added to
  * @param request pointer to an IOReqest to be enqueued 
 */
 void enqueueIO(IOQueue* queue, IORequest* request) {
-	if ((*queue).count == 0) {
+	(*request).queued_at = get_ticks();
+	(*request).next = NULL;
+	(*request).prev = (*queue).tail;
+
+	if ((*queue).count == 0)
 		(*queue).head = request;
-		(*queue).tail = request;
-		(*request).next = NULL;
-		(*request).prev = NULL;
-	} else {
+	else
 		(*(*queue).tail).next = request;
-		(*request).prev = (*queue).tail;
-		(*queue).tail = request;
-	}
+	(*queue).tail = request;
 
 	(*queue).count = (*queue).count + 1;
 }
 
 /**
- * This functions removes an IO request from the queue(FIFO). 
+ * This function works out the priority a waiting request is served at: the base priority of the
+ * process that made it, raised like processes in the ready queue by a level for every aging period
+ * (see sys_set_aging()) it has waited, up to the highest level, so a steady supply of high
+ * priority requests can't hold it off forever. With aging disabled it is just the base priority.
+ * @param request the waiting request
+ * @param now the current timer tick
+ * @param rate ticks of waiting per level gained, or 0 for none
+ * @return the priority to serve the request at
+*/
+static int aged_priority(IORequest* request, u32int now, int rate) {
+	int priority = (*(*request).process).base_priority;
+	if (rate == 0)
+		return priority;
+
+	u32int levels = (now - (*request).queued_at) / rate;
+
+	if (levels >= (u32int)(PRIORITY_LEVELS - 1 - priority))
+		return PRIORITY_LEVELS - 1;
+	return priority + levels;
+}
+
+/**
+ * This functions removes the next request to serve from the queue: the one with the highest
+ * aged priority, and the oldest of those if there are several.
  * @param queue a pointer to the IOQueue 
  * @return the IORequest that was removed
 */
 
 IORequest* dequeueIO(IOQueue* queue) {
-	IORequest* request;
-	if ((*queue).count == 0) {
+	if ((*queue).count == 0)
 		kpanic("Attempted to dequeue from empty queue");
-	} else {
-		queue->count -= 1;
-		request = queue->head;
-		
-		if (queue->head->next != NULL) {
-			queue->head = queue->head->next;
-			queue->head->prev = NULL;
+
+	IORequest* request = (*queue).head;
+	int rate = sys_get_aging();
+	u32int now = get_ticks();
+	int best = aged_priority(request, now, rate);
+	IORequest* other;
+	for (other = (*request).next; other != NULL; other = (*other).next) {
+		int priority = aged_priority(other, now, rate);
+		if (priority > best) {
+			best = priority;
+			request = other;
 		}
-		
 	}
+
+	if ((*request).prev != NULL)
+		(*(*request).prev).next = (*request).next;
+	else
+		(*queue).head = (*request).next;
+	if ((*request).next != NULL)
+		(*(*request).next).prev = (*request).prev;
+	else
+		(*queue).tail = (*request).prev;
+
+	(*queue).count = (*queue).count - 1;
 	return request;
 }
 
@@ -75,7 +124,7 @@ int nextIO(IOCB* iocb) {
 	if (iocb -> queue -> count > 0) {
 		IORequest* request = dequeueIO(iocb -> queue);
 		write_iocb(iocb, request);
-		sys_free_mem(request);
+		free_request(request);
 		return 1;
 	} else {
 		return 0;
@@ -9,6 +9,7 @@ typedef struct IORequest {
 	int op_code;
 	char *buffer_ptr;
 	int *count_ptr;
+	u32int queued_at; /// timer tick at which it was queued
 
 	struct IORequest* next;
 	struct IORequest* prev;
@@ -50,6 +51,7 @@ typedef struct IOCB {
 } IOCB;
 
 IORequest* make_request(int op_code, int device_id, char *buffer_ptr, int *count_ptr, PCB* currPCB);
+void free_request(IORequest* request);
 void enqueueIO(IOQueue* queue, IORequest* request);
 IORequest* dequeueIO(IOQueue* queue);
 int nextIO(IOCB* iocb);
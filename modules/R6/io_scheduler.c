@@ -41,6 +41,7 @@ void request_io(int op_code, int device_id, char *buffer_ptr, int *count_ptr, PC
 	if (iocb -> process == NULL) {
 		//Service the request now
 		write_iocb(iocb, request);
+		free_request(request);
 		service_request(iocb);
 	} else {
 		// Enqueue the request for later
@@ -54,7 +55,7 @@ void request_io(int op_code, int device_id, char *buffer_ptr, int *count_ptr, PC
 */
 void io_completion(IOCB* iocb) {
 
-	unblock_pcb(iocb -> process -> name);
+	unblock_pcb_ptr(iocb -> process);
 	iocb -> process = NULL;
 
 	// If there is another request waiting for that device, start it
@@ -64,6 +65,27 @@ void io_completion(IOCB* iocb) {
 }
 
 
+/**
+ * This function tells whether a process has I/O in progress or waiting for the device. Such a process
+ * can't be freed: the device is still writing into its buffer, or will be, and io_completion() will
+ * unblock it afterwards.
+ * @param pcb the process to check
+ * @return 1 if it has I/O outstanding, 0 otherwise
+*/
+int io_pending(PCB* pcb) {
+	if (iocb == NULL)
+		return 0;
+
+	int irqs = irq_save();
+	int pending = (iocb -> process == pcb);
+	IORequest* request;
+	for (request = iocb -> queue -> head; request != NULL && !pending; request = request -> next)
+		pending = (request -> process == pcb);
+	irq_restore(irqs);
+
+	return pending;
+}
+
 /**
  * Function to check when IOCB event flag is set. If it is set, return process to ready state, check queue for next request
  */
@@ -6,4 +6,5 @@ int* init_iocb();
 void request_io(int op_code, int device_id, char *buffer_ptr, int *count_ptr, PCB* currPCB);
 void io_completion(IOCB* iocb);
 void check_io();
+int io_pending(PCB* pcb);
 void service_request(IOCB* iocb);
\ No newline at end of file
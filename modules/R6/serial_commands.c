@@ -23,6 +23,7 @@
 static DCB* device;
 
 void first_level_int_handler(void);
+extern void serial_isr(void);
 void second_level_output_int_handler(void);
 void second_level_input_int_handler(void);
 
@@ -90,7 +91,7 @@ int com_open(int* e_flag, int baud_rate) {
 	//3) Save the address of the current interrupt handler, and install the new handler in the interrupt vector.
 
 	old_handler = idt_get_gate(IVT_ENTRY);
-	idt_set_gate(IVT_ENTRY, (u32int)first_level_int_handler, 0x08, 0x8E);
+	idt_set_gate(IVT_ENTRY, (u32int)serial_isr, 0x08, 0x8E); // stub in irq.s calls first_level_int_handler
 
 	//4) Compute the required baud rate divisor
 	long baud_rate_div = 115200 / (long) baud_rate;
@@ -346,11 +347,12 @@ void first_level_int_handler() {
 		}
 	}
 
-	sti();
-
 	// 4. Clear the interrupt by sending EOI to the PIC command register.
+	// This happens before sti() so a timer preemption can't leave IRQ4 in service.
 	outb(PIC_COMMAND, EOI);
 
+	sti();
+
 	//int i = 1; i=i; // unclear on why this works, but it avoids page faults
 }
 
@@ -9,8 +9,16 @@
 #include <mem/heap.h>
 #include <string.h>
 #include <core/serial.h>
+#include <core/io.h>
+#include <core/timer.h>
+#include <core/tsc.h>
+#include <mem/paging.h>
 #include "R2/Queue.h"
 #include "R2/PCB.h"
+#include "R2/PCBTable.h"
+#include "R3/loadr3.h"
+#include "R3/trace.h"
+#include "R4/timer_wheel.h"
 #include "R6/io_scheduler.h"
 
 // global variable containing parameter used when making 
@@ -21,6 +29,17 @@ static PCB* cop = NULL; /// currently operating process
 static PCB* fop = NULL; /// formerly operating process
 static Context* old_context = NULL;
 
+static u32int* dispatch(Queue* readyQueue);
+
+static int quantum = DEFAULT_QUANTUM; /// length of a time slice, in timer ticks
+static int slice_left = DEFAULT_QUANTUM; /// ticks left in the running process's time slice
+static int aging_rate = DEFAULT_AGING_RATE; /// ticks of waiting per priority level gained, 0 for none
+static u64int idle_cycles = 0; /// cycles spent halted with nothing to run
+
+static PCB* zombies = NULL; /// exited processes whose memory hasn't been reclaimed yet
+static u32int zombies_reaped = 0; /// number of exited processes reclaimed
+static u32int bytes_reaped = 0; /// PCB and stack bytes reclaimed from them
+
 // global for the current module
 int current_module = 6;
 static int io_module_active = 0;
@@ -34,6 +53,10 @@ u32int (*student_malloc)(u32int);
 // is a pointer to the student's "free" operation.
 int (*student_free)(void *);
 
+// if a student created heap manager is implemented this
+// is a pointer to the student's "realloc" operation.
+u32int (*student_realloc)(void *, u32int);
+
 
 
 /* *********************************************
@@ -41,7 +64,7 @@ int (*student_free)(void *);
 *	for service.  
 *
 *	Parameters:  op_code:  Requested Operation, one of
-*					READ, WRITE, IDLE, EXIT
+*					READ, WRITE, IDLE, EXIT, SLEEP, SPAWN
 *			  device_id:  For READ & WRITE this is the
 *					  device to which the request is 
 *					  sent.  One of DEFAULT_DEVICE or
@@ -50,7 +73,14 @@ int (*student_free)(void *);
 *					to be used with READ & WRITE request
 *			   count_ptr:  pointer to an integer variable
 *					 containing the number of characters
-*					 to be read or written
+*					 to be read or written, or for SLEEP
+*					 the number of milliseconds to sleep
+*
+*	SPAWN creates a process running proc(arg) and places it in
+*	the ready queue; buffer_ptr points to a spawn_params
+*	describing it, whose child member is set to the new PCB.
+*	The caller keeps the CPU unless the child has a higher
+*	priority.
 *
 *************************************************/
 int sys_req( 	int  op_code,
@@ -60,12 +90,16 @@ int sys_req( 	int  op_code,
 
 {
 	int return_code =0;
+  int irqs;
 
   if (op_code == IDLE || op_code == EXIT){
     // store the process's operation request
     // triger interrupt 60h to invoke
+    // (irqs stay off so the timer can't preempt us between the two)
+    irqs = irq_save();
     params.op_code = op_code;
   	asm volatile ("int $60");
+    irq_restore(irqs);
   }// idle or exit
 
   else if (op_code == READ || op_code == WRITE) {
@@ -77,6 +111,7 @@ int sys_req( 	int  op_code,
 
     // if parameters are valid store in the params structure
     if ( return_code == 0){ 
+      irqs = irq_save();
       params.op_code = op_code;
       params.device_id = device_id;
       params.buffer_ptr = buffer_ptr;
@@ -93,6 +128,38 @@ int sys_req( 	int  op_code,
       } else {// I/O module is implemented
         asm volatile ("int $60");
       } // NOT IO_MODULE
+      irq_restore(irqs);
+    }
+  }
+
+  else if (op_code == SLEEP) {
+    if (count_ptr == NULL || *count_ptr < 0)
+      return_code = INVALID_COUNT;
+    else {
+      irqs = irq_save();
+      params.op_code = op_code;
+      params.count_ptr = count_ptr;
+      asm volatile ("int $60");
+      irq_restore(irqs);
+    }
+  }
+
+  else if (op_code == SPAWN) {
+    spawn_params *spawn = (spawn_params *) buffer_ptr;
+    if (spawn == NULL)
+      return_code = INVALID_BUFFER;
+    else if ((*spawn).name == NULL || strlen((*spawn).name) == 0 || strlen((*spawn).name) > 20
+        || (*spawn).proc == NULL || (*spawn).priority < 0 || (*spawn).priority > 9
+        || ((*spawn).stack_size != 0 && (*spawn).stack_size < MIN_SPAWN_STACK))
+      return_code = INVALID_SPAWN;
+    else {
+      irqs = irq_save();
+      params.op_code = op_code;
+      params.buffer_ptr = buffer_ptr;
+      asm volatile ("int $60");
+      irq_restore(irqs);
+      if ((*spawn).child == NULL)
+        return_code = SPAWN_FAILED;
     }
   } else return_code = INVALID_OPERATION;
   
@@ -133,6 +200,16 @@ void sys_set_malloc(u32int (*func)(u32int))
   student_malloc = func;
 }
 
+/*
+  Procedure..: sys_set_realloc
+  Description..: Sets the memory reallocation function for sys_realloc_mem
+  Params..: Function pointer
+*/
+void sys_set_realloc(u32int (*func)(void *, u32int))
+{
+  student_realloc = func;
+}
+
 /*
   Procedure..: sys_set_free
   Description..: Sets the memory free function for sys_free_mem
@@ -143,6 +220,85 @@ void sys_set_free(int (*func)(void *))
   student_free = func;
 }
 
+/*
+  Procedure..: sys_set_quantum
+  Description..: Sets the length of the time slice given to a process
+			before the timer preempts it
+  Params..: ticks - number of timer ticks per time slice (at least 1)
+*/
+void sys_set_quantum(int ticks)
+{
+  if (ticks < 1)
+    ticks = 1;
+  quantum = ticks;
+}
+
+/*
+  Procedure..: sys_get_quantum
+  Description..: Returns the length of the time slice in timer ticks
+*/
+int sys_get_quantum()
+{
+  return quantum;
+}
+
+/*
+  Procedure..: sys_set_aging
+  Description..: Sets how quickly processes waiting in the ready queue
+			are raised in priority
+  Params..: ticks - ticks of waiting per priority level gained, 0 to
+			disable aging
+*/
+void sys_set_aging(int ticks)
+{
+  if (ticks < 0)
+    ticks = 0;
+  aging_rate = ticks;
+}
+
+/*
+  Procedure..: sys_get_aging
+  Description..: Returns the aging rate in ticks per priority level,
+			or 0 if aging is disabled
+*/
+int sys_get_aging()
+{
+  return aging_rate;
+}
+
+/*
+  Procedure..: get_running_pcb
+  Description..: Returns the PCB of the process currently on the CPU,
+			or NULL if the dispatcher isn't running a process
+*/
+PCB* get_running_pcb()
+{
+  return cop;
+}
+
+/*
+  Procedure..: sys_get_idle_cycles
+  Description..: Returns the number of CPU cycles the dispatcher has
+			spent halted because no process was ready
+*/
+u64int sys_get_idle_cycles()
+{
+  return idle_cycles;
+}
+
+/*
+  Procedure..: sys_get_reaped
+  Description..: Reports how many exited processes have had their
+			memory reclaimed, and how much memory that was
+  Params..: count - set to the number of processes reclaimed
+			bytes - set to the number of PCB and stack bytes reclaimed
+*/
+void sys_get_reaped(u32int* count, u32int* bytes)
+{
+  *count = zombies_reaped;
+  *bytes = bytes_reaped;
+}
+
 /*
   Procedure..: sys_alloc_mem
   Description..: Allocates a block of memory (similar to malloc)
@@ -150,15 +306,59 @@ void sys_set_free(int (*func)(void *))
 */
 void *sys_alloc_mem(u32int size)
 {
+  void *mem;
+  int irqs = irq_save(); // the heap is shared by every process
+
   if (!mem_module_active)
-    return (void *) kmalloc(size);
+    mem = (void *) kmalloc(size);
   else
   {
     //klogv("In sys_alloc_mem");
-    return (void *) (*student_malloc)(size);
+    mem = (void *) (*student_malloc)(size);
   }
+
+  irq_restore(irqs);
+  return mem;
+}
+
+
+/*
+  Procedure..: sys_realloc_mem
+  Description..: Resizes a block of memory, keeping its contents (similar
+			to realloc). kmalloc doesn't record block sizes, so this
+			needs the memory module.
+  Params..: ptr-block to resize (NULL to allocate), size-bytes it needs
+*/
+void *sys_realloc_mem(void *ptr, u32int size)
+{
+  if (ptr == NULL)
+    return sys_alloc_mem(size);
+
+  void *mem = NULL;
+  int irqs = irq_save();
+
+  if (mem_module_active && student_realloc != NULL)
+    mem = (void *) (*student_realloc)(ptr, size);
+
+  irq_restore(irqs);
+  return mem;
 }
 
+/*
+  Procedure..: sys_calloc_mem
+  Description..: Allocates a zeroed array (similar to calloc)
+  Params..: count-number of elements, size-bytes per element
+*/
+void *sys_calloc_mem(u32int count, u32int size)
+{
+  if (size != 0 && count > 0xFFFFFFFF / size)
+    return NULL; // the total doesn't fit in 32 bits
+
+  void *mem = sys_alloc_mem(count * size);
+  if (mem != NULL)
+    memset(mem, 0, count * size);
+  return mem;
+}
 
 /*
   Procedure..: sys_free_mem
@@ -167,10 +367,15 @@ void *sys_alloc_mem(u32int size)
 */
 int sys_free_mem(void *ptr)
 {
+  int rc = -1;
+  int irqs = irq_save();
+
   if (mem_module_active)
-    return (*student_free)(ptr);
+    rc = (*student_free)(ptr);
   // otherwise we don't free anything
-  return -1;
+
+  irq_restore(irqs);
+  return rc;
 }
 
 /*
@@ -195,6 +400,39 @@ void idle()
   }
 }
 
+/**
+ * This function frees the PCB and stack of every process that has exited. An exiting process
+ * is still running on its own stack when sys_call handles the EXIT, so its memory can only be
+ * reclaimed later, from another process's stack. Callers must make sure they are running on
+ * the stack of a live process (cop != NULL).
+*/
+static void reap_zombies() {
+  while (zombies != NULL) {
+    PCB* zombie = zombies;
+    zombies = (*zombie).next;
+
+    u32int stack_pages = ((*zombie).stack_size + PAGE_SIZE - 1) / PAGE_SIZE;
+    bytes_reaped += sizeof(PCB) + stack_pages * PAGE_SIZE;
+    zombies_reaped++;
+    free_pcb(zombie);
+  }
+}
+
+/**
+ * This function charges the running process for the CPU time it has used since it was
+ * dispatched, as it gives up the CPU.
+ * 
+ * @param pcb - the process leaving the CPU
+ * @param voluntary - nonzero if it called sys_req, zero if the timer preempted it
+*/
+static void charge_pcb(PCB* pcb, int voluntary) {
+  (*pcb).run_cycles += rdtsc() - (*pcb).dispatched_at;
+  if (voluntary)
+    (*pcb).voluntary_switches++;
+  else
+    (*pcb).involuntary_switches++;
+}
+
 /**
  * This function performs a context switch between two processes. 
  * 
@@ -203,18 +441,66 @@ void idle()
 */
 u32int* sys_call(Context* registers) {
 
-  check_io();
+  check_io(); // first, since finished I/O may make a process ready
 
   Queue* readyQueue = getReadyQueue();
 
+  // Fast path for the most common request: a yield with nothing else ready. The process just
+  // carries on with its time slice, so there is nothing to charge, queue, dispatch or reap
+  // (the timer reaps exited processes too).
+  if (params.op_code == IDLE && cop != NULL && (*readyQueue).head == NULL) {
+    trace_switch(IDLE, cop, cop, 0);
+    return (u32int*)registers;
+  }
+
+  if (cop != NULL && zombies != NULL)
+    reap_zombies(); // safe now that we're on a live process's stack
+
+  if (params.op_code == SPAWN) {
+    spawn_params* spawn = (spawn_params*)params.buffer_ptr;
+    u32int stack_size = ((*spawn).stack_size == 0) ? DEFAULT_STACK_SIZE : (*spawn).stack_size;
+    enum proc_types type = (cop == NULL) ? System : (*cop).type; // children share their parent's class
+    (*spawn).child = spawn_proc((*spawn).name, type, (*spawn).priority, (*spawn).proc, (*spawn).arg, stack_size);
+
+    // the parent carries on, unless its child outranks it and should run first
+    if (cop == NULL || (*spawn).child == NULL || (*(*spawn).child).priority <= (*cop).priority) {
+      trace_switch(SPAWN, cop, cop, (*readyQueue).count);
+      return (u32int*)registers;
+    }
+  }
+
+  PCB* outgoing = cop;
+  int ready = (*readyQueue).count;
+
+  if (cop != NULL)
+    charge_pcb(cop, 1); // whatever it asked for, it is leaving the CPU
+
   if (cop == NULL) {
     old_context = registers;
   }
-  else if (params.op_code == IDLE) {
+  else if (params.op_code == IDLE || params.op_code == SPAWN) {
     (cop -> stack_top) = (unsigned char*)registers;
     fop = cop;
   }
+  else if (params.op_code == SLEEP) {
+    (cop -> stack_top) = (unsigned char*)registers;
+    u32int ticks = ms_to_ticks(*params.count_ptr);
+    if (ticks == 0) {
+      fop = cop; // nothing to wait for, so this is just a yield
+    }
+    else {
+      // off the CPU until the timer wheel wakes it; it is never dispatched in the meantime
+      cop -> state = Blocked;
+      enqueuePCB(getBlockedQueue(), cop, 1);
+      sleep_pcb(cop, get_ticks() + ticks);
+      cop = NULL;
+    }
+  }
   else if (params.op_code == EXIT) {
+    unindex_pcb(cop); // the name can be reused from now on
+    // we are still on its stack, so leave the freeing to reap_zombies()
+    (*cop).next = zombies;
+    zombies = cop;
     cop = NULL;
   } 
   else if (params.op_code == WRITE) {
@@ -242,21 +528,119 @@ u32int* sys_call(Context* registers) {
     kpanic("Invalid opcode for sys_call");
   }
 
-  if((*readyQueue).head != NULL) {
+  u32int* next = dispatch(readyQueue);
+  trace_switch(params.op_code, outgoing, cop, ready);
+  return next;
+}
+
+/**
+ * This function selects the next process to run. The front of the highest non-empty priority
+ * level of the ready queue is made the running process, and the formerly operating process (if any) is placed back into the
+ * ready queue. A fresh time slice is started for whichever process is dispatched. When nothing
+ * is ready, the CPU is halted until an interrupt readies a blocked process.
+ * 
+ * @param readyQueue - the ready queue
+ * @return a new value for the ESP register to change context
+*/
+static u32int* dispatch(Queue* readyQueue) {
+
+  slice_left = quantum;
+
+  PCB* next = dequeuePCB(readyQueue);
+
+  // Nothing is runnable and the outgoing process can't continue. Rather than spinning an idle
+  // process, halt until an interrupt (I/O completion or timer) makes something ready. This
+  // only makes sense while some process is blocked; otherwise nothing can ever run again.
+  if (next == NULL && fop == NULL) {
+    Queue* blockedQueue = getBlockedQueue();
+    u64int halted_at = rdtsc();
+    while ((*readyQueue).head == NULL && (*blockedQueue).count > 0) {
+      asm volatile ("sti\n\thlt\n\tcli"); // sti delays irqs by one instruction, so no wakeup is lost
+      check_io();
+    }
+    idle_cycles += rdtsc() - halted_at;
+    next = dequeuePCB(readyQueue);
+  }
+
+  if(next != NULL) {
   
-    cop = (*readyQueue).head;
-    delete_pcb((*cop).name);
+    cop = next;
     (*cop).state = Running;
+    (*cop).priority = (*cop).base_priority; // it has stopped waiting, so give up any aging
+    (*cop).dispatches++;
+    (*cop).dispatched_at = rdtsc();
 
     if (fop != NULL) {
+      (*fop).state = Ready;
       enqueuePCB(readyQueue, fop, 0);
       fop = NULL;
     }
 
     return (u32int*)(*cop).stack_top;
   }
+  else if (fop != NULL) {
+    // nothing else is ready, so the yielding process keeps running
+    cop = fop;
+    fop = NULL;
+    (*cop).dispatches++;
+    (*cop).dispatched_at = rdtsc();
+    return (u32int*)(*cop).stack_top;
+  }
   else {
     return (u32int*)old_context;
   }
 
+}
+
+/**
+ * This function is called by the timer interrupt (IRQ0) on every tick. It acknowledges
+ * the interrupt and, once the running process has used up its time slice (or a higher
+ * priority process has become ready), preempts it by placing it back into the ready queue
+ * and dispatching the next ready process. If nothing else is ready, the running process
+ * simply starts a new time slice.
+ * 
+ * @param registers - the context of the interrupted process
+ * @return a new value for the ESP register to change context
+*/
+u32int* timer_call(Context* registers) {
+
+  timer_tick();
+  outb(0x20, 0x20); // EOI, before we may switch away
+
+  // wake sleepers, even while the dispatcher is halted waiting for one
+  advance_timer_wheel(get_ticks());
+
+  // nothing to preempt until the first dispatch (or after shutdown)
+  if (cop == NULL)
+    return (u32int*)registers;
+
+  // notice finished I/O on every tick, and let a process it readied at a higher
+  // priority run now rather than at the end of the time slice
+  check_io();
+
+  if (zombies != NULL)
+    reap_zombies();
+
+  Queue* readyQueue = getReadyQueue();
+  u32int now = get_ticks();
+  if (aging_rate != 0 && now % aging_rate == 0)
+    age_ready_pcbs(now, aging_rate);
+
+  if (--slice_left > 0 && highest_priority(readyQueue) <= (*cop).priority)
+    return (u32int*)registers;
+
+  if ((*readyQueue).head == NULL) {
+    slice_left = quantum;
+    return (u32int*)registers;
+  }
+
+  (cop -> stack_top) = (unsigned char*)registers;
+  charge_pcb(cop, 0);
+  fop = cop;
+
+  PCB* outgoing = cop;
+  int ready = (*readyQueue).count;
+  u32int* next = dispatch(readyQueue);
+  trace_switch(TRACE_PREEMPT, outgoing, cop, ready);
+  return next;
 }
\ No newline at end of file
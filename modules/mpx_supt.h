@@ -10,6 +10,8 @@
 #define READ 2
 #define WRITE 3
 #define INVALID_OPERATION 4
+#define SLEEP 5
+#define SPAWN 6
 
 #define TRUE  1
 #define FALSE  0
@@ -26,6 +28,14 @@
 // error codes
 #define INVALID_BUFFER 1000
 #define INVALID_COUNT 2000
+#define INVALID_SPAWN 3000
+#define SPAWN_FAILED 4000
+
+// default time slice, in timer ticks
+#define DEFAULT_QUANTUM 5
+
+// default ticks a ready process must wait to be raised one priority level
+#define DEFAULT_AGING_RATE 50
 
 #define DEFAULT_DEVICE 111
 #define COM_PORT 222
@@ -37,10 +47,26 @@ typedef struct {
   int *count_ptr;
 } param;
 
+// what to create for a SPAWN request, passed as its buffer_ptr
+typedef struct {
+  char *name;          // name of the new process, 1-20 characters and not in use
+  void *proc;          // function the new process runs
+  void *arg;           // argument passed to proc
+  int priority;        // priority of the new process, 0-9
+  u32int stack_size;   // stack size in bytes, 0 for DEFAULT_STACK_SIZE, else at least MIN_SPAWN_STACK
+  struct PCB *child;   // set to the new process, or NULL if it couldn't be created
+} spawn_params;
+
+// smallest stack a SPAWN may ask for: room for the initial context and the
+// call frame above it (see init_context)
+#define MIN_SPAWN_STACK (sizeof(Context) + 2 * sizeof(u32int))
+
 /*
   Procedure..: sys_req
   Description..: Generate interrupt 60H
-  Params..: int op_code one of (IDLE, EXIT, READ, WRITE)
+  Params..: int op_code one of (IDLE, EXIT, READ, WRITE, SLEEP, SPAWN)
+			(SLEEP takes the number of milliseconds in *count_ptr,
+			SPAWN takes a spawn_params as buffer_ptr)
 */
 int sys_req( int op_code, int device_id, char *buffer_ptr, 
 			int *count_ptr );
@@ -59,6 +85,13 @@ void mpx_init(int cur_mod);
 */
 void sys_set_malloc(u32int (*func)(u32int));
 
+/*
+  Procedure..: sys_set_realloc
+  Description..: Sets the memory reallocation function for sys_realloc_mem
+  Params..: Function pointer
+*/
+void sys_set_realloc(u32int (*func)(void *, u32int));
+
 /*
   Procedure..: sys_set_free
   Description..: Sets the memory free function for sys_free_mem
@@ -66,6 +99,53 @@ void sys_set_malloc(u32int (*func)(u32int));
 */
 void sys_set_free(int (*func)(void *));
 
+/*
+  Procedure..: sys_set_quantum
+  Description..: Sets the length of the time slice given to a process
+			before the timer preempts it
+  Params..: ticks - number of timer ticks per time slice (at least 1)
+*/
+void sys_set_quantum(int ticks);
+
+/*
+  Procedure..: sys_get_quantum
+  Description..: Returns the length of the time slice in timer ticks
+*/
+int sys_get_quantum();
+
+/*
+  Procedure..: sys_set_aging
+  Description..: Sets how quickly waiting processes are aged
+  Params..: ticks - ticks of waiting per priority level gained, 0 to disable aging
+*/
+void sys_set_aging(int ticks);
+
+/*
+  Procedure..: sys_get_aging
+  Description..: Returns the aging rate in ticks per priority level, 0 if disabled
+*/
+int sys_get_aging();
+
+/*
+  Procedure..: get_running_pcb
+  Description..: Returns the PCB of the process currently on the CPU,
+			or NULL if the dispatcher isn't running a process
+*/
+struct PCB* get_running_pcb();
+
+/*
+  Procedure..: sys_get_reaped
+  Description..: Reports how many exited processes have had their
+			memory reclaimed, and how many bytes that freed
+*/
+void sys_get_reaped(u32int* count, u32int* bytes);
+
+/*
+  Procedure..: sys_get_idle_cycles
+  Description..: Returns the number of CPU cycles the dispatcher has
+			spent halted because no process was ready
+*/
+u64int sys_get_idle_cycles();
 
 
 /*
@@ -75,6 +155,21 @@ void sys_set_free(int (*func)(void *));
 */
 void *sys_alloc_mem(u32int size);
 
+/*
+  Procedure..: sys_realloc_mem
+  Description..: Resizes a block of memory, keeping its contents (similar
+			to realloc). Requires the memory module.
+  Params..: ptr-block to resize (NULL to allocate), size-bytes it needs
+*/
+void *sys_realloc_mem(void *ptr, u32int size);
+
+/*
+  Procedure..: sys_calloc_mem
+  Description..: Allocates a zeroed array (similar to calloc)
+  Params..: count-number of elements, size-bytes per element
+*/
+void *sys_calloc_mem(u32int count, u32int size);
+
 /*
   Procedure..: sys_free_mem
   Description..: Frees memory
@@ -91,4 +186,6 @@ void idle();
 
 u32int* sys_call(Context* registers); 
 
+u32int* timer_call(Context* registers);
+
 #endif